@@ -1,3 +1,12 @@
-gcc -o ea_orthoderivative src/ea_orthoderivative.c src/equivalence.c src/orthoderivative.c src/structures.c src/adjoint.c
-gcc -o affine src/affine.c src/equivalence.c src/orthoderivative.c src/structures.c src/adjoint.c
-gcc -o linear src/linear.c src/equivalence.c src/orthoderivative.c src/structures.c src/adjoint.c
+# bash compile.sh avx2, or avx512, builds the vector paths of the bit-sliced kernels; they need the optimizer to inline
+case "$1" in
+    avx2) FLAGS="-O2 -mavx2" ;;
+    avx512) FLAGS="-O2 -mavx512f" ;;
+    *) FLAGS="" ;;
+esac
+gcc $FLAGS -o ea_orthoderivative src/ea_orthoderivative.c src/equivalence.c src/orthoderivative.c src/structures.c src/adjoint.c src/control.c src/output.c src/dispatch.c src/store.c src/automorphism.c src/permutation.c src/bitslice.c src/taskgraph.c -pthread
+gcc $FLAGS -o affine src/affine.c src/equivalence.c src/orthoderivative.c src/structures.c src/adjoint.c src/control.c src/output.c src/dispatch.c src/store.c src/automorphism.c src/permutation.c src/bitslice.c src/taskgraph.c -pthread
+gcc $FLAGS -o linear src/linear.c src/equivalence.c src/orthoderivative.c src/structures.c src/adjoint.c src/control.c src/output.c src/dispatch.c src/store.c src/automorphism.c src/permutation.c src/bitslice.c src/taskgraph.c -pthread
+gcc $FLAGS -o equivalence src/frontend.c src/equivalence.c src/orthoderivative.c src/structures.c src/adjoint.c src/control.c src/output.c src/dispatch.c src/store.c src/automorphism.c src/permutation.c src/bitslice.c src/taskgraph.c -pthread
+gcc $FLAGS -o coordinator src/coordinator.c
+gcc $FLAGS -o classify src/classify.c src/canonical.c src/permutation.c src/equivalence.c src/structures.c src/control.c src/output.c src/bitslice.c src/prefetch.c -pthread
@@ -8,11 +8,11 @@
  */
 _Bool dot(size_t a, size_t b);
 
-/* Finds the adjoint operator of the linear permutation L */
 /**
- * Finds the adjoint operator of the linear permutation L
- * @param L Linear permutation
- * @return The adjoint of a linear permutation L
+ * Finds the adjoint operator L* of the linear function L, with x . L*(y) = L(x) . y for all x, y. Its matrix is the
+ * transpose of the matrix of L.
+ * @param L Linear function
+ * @return The adjoint of L
  */
 TruthTable *adjoint(TruthTable *L);
 
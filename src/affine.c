@@ -1,7 +1,8 @@
 #include <time.h>
 #include "structures.h"
 #include "equivalence.h"
-#include "orthoderivative.h"
+#include "control.h"
+#include "dispatch.h"
 
 /**
  * Print out a list over all the flags that can be used in the program
@@ -9,90 +10,52 @@
 void printHelp();
 
 int main(int argc, char *argv[]) {
-    size_t n; // Working n
-    size_t *basis; // List of the standard basis, {b_1, ..., b_n}
     RunTimes *runTime;
-    bool times = false;
     clock_t startTotalTime;
-    TruthTable *functionF = NULL;
-    TruthTable *functionG = NULL;
-
-    // Check for flags
-    if (argc < 2) {
-        printHelp();
-        return 0;
+    SearchControl *control = initSearchControl(); // Time budget, cancellation and checkpoints
+    QueryArguments arguments;
+    arguments.type = AFFINE_EQUIVALENCE;
+    int exitStatus;
+    if (!parseQueryArguments(argc, argv, control, &arguments, false, printHelp, &exitStatus)) {
+        destroySearchControl(control);
+        return exitStatus;
     }
     startTotalTime = clock();
     runTime = initRunTimes();
 
-    // Loop over the arguments given
-    for (int i = 1; i < argc; ++i) {
-        if (argv[i][0] == '-') {
-            switch (argv[i][1]) {
-                case 'h':
-                    printHelp();
-                    return 0;
-                case 't':
-                    times = true;
-                    i++;
-                    continue;
-            }
-        } else {
-            if (functionF == NULL) {
-                functionF = parseFile(argv[i]);
-                printf("%s\n", argv[i]);
-            } else if (functionG == NULL) {
-                functionG = parseFile(argv[i]);
-            }
-        }
-    }
-    if (functionF == NULL) {
-        printf("Missing function F. \n");
-        return 0;
-    }
-    n = functionF->n;
-
-    if (functionG == NULL) {
-        functionG = createAffineTruthTable(functionF); // Create a random function G with respect to F
+    if (arguments.functionG == NULL) {
+        // Create a random function G with respect to F
+        arguments.functionG = createAffineTruthTable(arguments.functionF);
         printf("G:\n");
-        printTruthTable(functionG);
+        printTruthTable(arguments.functionG);
     }
-    TruthTable *orthoderivativeF = orthoderivative(functionF); // The orthoderivative of F
-    TruthTable *orthoderivativeG = orthoderivative(functionG); // The orthoderivative of G
-
-    Partition *partitionF = partitionTt(orthoderivativeF); // The partition of the orthoderivative of F
-    basis = createStandardBasis(n); // Basis {b_1, ..., b_n}, here we use the standard basis.
-
-    bool foundSolution = false;
-    for (int c1 = 0; c1 < 1L << n; ++c1) {
-        TruthTable *ODGc = initTruthTable(n); // ODGc' = orthoderivativeG + c_1
-        memcpy(ODGc->elements, orthoderivativeG->elements, sizeof(size_t) * 1L << n);
-        addConstant(ODGc, c1); // Add the constant c1 to ODGc: ODGc' = ODGc + c_1
-        Partition *partitionG = partitionTt(ODGc);
-        size_t *mapOfPreImages = mapPreImages(partitionF, partitionG); // Create a mapping between the pre-images of F and ODGc
-
-        // Calculate outer permutation, A1
-        foundSolution = outerPermutation(partitionF, partitionG, n, basis, mapOfPreImages, orthoderivativeF, ODGc, true);
-
-        destroyTruthTable(ODGc);
-        destroyPartition(partitionG);
-        free(mapOfPreImages);
+    PreparedFunction *preparedF;
+    PreparedFunction *preparedG;
+    startQuery(control, "affine", &arguments, &preparedF, &preparedG);
 
-        if (foundSolution) break;
+    /* The orthoderivative approach only applies if both functions are quadratic APN, which their degrees tell as soon
+     * as they are prepared; other functions are sent to the dispatcher before any orthoderivative is computed */
+    bool foundSolution;
+    if (!preparedF->quadraticApn || !preparedG->quadraticApn) {
+        printf("Orthoderivative not working for one of the functions (degrees %zu and %zu)\n", preparedF->degree,
+               preparedG->degree);
+        foundSolution = dispatchQuery(preparedF, preparedG, AFFINE_EQUIVALENCE, control);
+    } else {
+        // Need to test for all possible constants, 0..2^n - 1, and calculate outer permutation, A1, for each of them
+        foundSolution = control->status == SEARCH_RUNNING &&
+                        searchOrthoderivatives(preparedF, preparedG, true, control);
     }
+    SearchStatus status = finishSearchControl(control, foundSolution);
 
-    destroyTruthTable(functionF);
-    destroyTruthTable(functionG);
-    destroyTruthTable(orthoderivativeF);
-    destroyTruthTable(orthoderivativeG);
-    destroyPartition(partitionF);
-    free(basis);
+    destroyPreparedFunction(preparedF);
+    destroyPreparedFunction(preparedG);
     runTime->total = stopTime(runTime->total, startTotalTime);
-    if (times) {
+    if (arguments.times) {
         printTimes(runTime);
     }
     destroyRunTimes(runTime);
-    return 0;
+    destroySearchControl(control);
+    return status;
 }
 
 void printHelp() {
@@ -101,6 +64,7 @@ void printHelp() {
     printf("Affine_options:\n");
     printf("\t-h \t- Print help\n");
     printf("\t-t \t- Print run time\n");
+    printControlHelp();
     printf("\n");
     printf("\tfilenameF = the path to file of function F\n");
     printf("\tfilenameG = the path to file of function G\n");
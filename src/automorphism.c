@@ -0,0 +1,131 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <memory.h>
+#include "structures.h"
+#include "equivalence.h"
+#include "permutation.h"
+#include "automorphism.h"
+
+/**
+ * The state of the search for an automorphism (A, B) of F
+ */
+typedef struct AutomorphismSearch {
+    TruthTable *F; // The function F
+    Partition *partition; // The partition of F, which A must preserve
+    size_t *basis; // The standard basis
+    PartialLinearMap *A; // The partial outer permutation
+    size_t nodes; // Number of nodes expanded so far
+    size_t budget; // Number of nodes the search may expand
+} AutomorphismSearch;
+
+/**
+ * Check that the points of A from index first on map every element to an element of the same bucket
+ */
+static bool bucketsPreserved(AutomorphismSearch *search, size_t first) {
+    size_t *bucketOf = search->partition->bucketOf;
+    for (size_t p = first; p < search->A->count; ++p) {
+        size_t x = search->A->points[p];
+        if (bucketOf[x] != bucketOf[search->A->values[x]]) return false;
+    }
+    return true;
+}
+
+/**
+ * Guess the image of basis element k under A, as guessValuesOfL does for L1 with G = F, and check for B at the leaves
+ */
+static bool extendAutomorphism(AutomorphismSearch *search, size_t k) {
+    TruthTable *F = search->F;
+    size_t n = F->n;
+    PartialLinearMap *A = search->A;
+    if (k == n) {
+        TruthTable *outer = initTruthTable(n);
+        memcpy(outer->elements, A->values, sizeof(size_t) * 1L << n);
+        TruthTable *outerInverse = inverse(outer);
+        TruthTable *FPrime = compose(outerInverse, F); // A^{-1} * F = F * B
+        TruthTable *B = initTruthTable(n);
+        bool found = innerPermutation(F, FPrime, search->basis, B, false);
+        destroyTruthTable(outer);
+        destroyTruthTable(outerInverse);
+        destroyTruthTable(FPrime);
+        destroyTruthTable(B);
+        return found;
+    }
+    if (++search->nodes > search->budget) return false;
+
+    Partition *partition = search->partition;
+    size_t bucket = partition->bucketOf[search->basis[k]];
+    for (size_t j = partition->offsets[bucket]; j < partition->offsets[bucket + 1]; ++j) {
+        size_t image = partition->elements[j];
+        if (A->usedImages[image]) continue;
+        size_t count = A->count;
+        if (addPoint(A, search->basis[k], image) && bucketsPreserved(search, count) &&
+            extendAutomorphism(search, k + 1)) {
+            return true;
+        }
+        resetPoints(A, count);
+        if (search->nodes > search->budget) return false;
+    }
+    return false;
+}
+
+AutomorphismOrbit *computeAutomorphismOrbit(TruthTable *F, Partition *partition, size_t budget) {
+    size_t n = F->n;
+    AutomorphismOrbit *orbit = malloc(sizeof(AutomorphismOrbit));
+    orbit->n = n;
+    orbit->members = calloc(sizeof(bool), 1L << n);
+    orbit->generators = 0;
+
+    AutomorphismSearch search;
+    search.F = F;
+    search.partition = partition;
+    search.basis = createStandardBasis(n);
+    search.A = initPartialLinearMap(n);
+    search.budget = budget;
+
+    size_t first = search.basis[0];
+    size_t *members = malloc(sizeof(size_t) * 1L << n); // The elements of the orbit, in the order they were found
+    size_t **generators = malloc(sizeof(size_t *) * 1L << n); // The outer permutations found
+    members[0] = first;
+    orbit->members[first] = true;
+    orbit->size = 1;
+
+    size_t bucket = partition->bucketOf[first];
+    for (size_t j = partition->offsets[bucket]; j < partition->offsets[bucket + 1]; ++j) {
+        size_t u = partition->elements[j];
+        if (orbit->members[u]) continue;
+
+        // Search for an automorphism with A(b_1) = u
+        resetPoints(search.A, 1);
+        search.nodes = 0;
+        if (!addPoint(search.A, first, u) || !extendAutomorphism(&search, 1)) continue;
+
+        size_t *generator = malloc(sizeof(size_t) * 1L << n);
+        memcpy(generator, search.A->values, sizeof(size_t) * 1L << n);
+        generators[orbit->generators++] = generator;
+
+        // Close the orbit under all the generators found so far
+        for (size_t i = 0; i < orbit->size; ++i) {
+            for (size_t g = 0; g < orbit->generators; ++g) {
+                size_t image = generators[g][members[i]];
+                if (!orbit->members[image]) {
+                    orbit->members[image] = true;
+                    members[orbit->size++] = image;
+                }
+            }
+        }
+    }
+
+    for (size_t g = 0; g < orbit->generators; ++g) {
+        free(generators[g]);
+    }
+    free(generators);
+    free(members);
+    free(search.basis);
+    destroyPartialLinearMap(search.A);
+    return orbit;
+}
+
+void destroyAutomorphismOrbit(AutomorphismOrbit *orbit) {
+    free(orbit->members);
+    free(orbit);
+}
@@ -0,0 +1,43 @@
+#ifndef AFFINE_AUTOMORPHISM_H
+#define AFFINE_AUTOMORPHISM_H
+
+#include "structures.h"
+
+/**
+ * In automorphism, you will find the automorphisms of a function F, i.e. the pairs of linear permutations (A, B) with
+ * A * F * B = F. If L1 * F * L2 = G, then also (L1 * A) * F * (B * L2) = G, so the search for L1 only has to try one
+ * L1 out of every set {L1 * A}. The search keeps the L1 whose image of the first basis element b_1 is the smallest
+ * among the images of the orbit {A(b_1)}, and cuts every branch where some element u of that orbit already has
+ * L1(u) < L1(b_1).
+ */
+
+/**
+ * The orbit of the first basis element under the outer parts A of the automorphisms of F that were found
+ */
+typedef struct AutomorphismOrbit {
+    size_t n; // Dimension
+    bool *members; // members[u] is true if u = A(b_1) for some automorphism (A, B)
+    size_t size; // Number of elements in the orbit
+    size_t generators; // Number of automorphisms found to generate the orbit
+} AutomorphismOrbit;
+
+/**
+ * Compute the orbit of the first basis element of the standard basis under the automorphisms of F. For every element
+ * u of the bucket of b_1 that is not in the orbit yet, we search for an automorphism with A(b_1) = u, reusing the
+ * search for L1 with G = F, and close the orbit under the automorphisms found. The search for each u is limited to a
+ * number of nodes; if it runs out, u is left out, and the orbit is the orbit of a subgroup, which still breaks
+ * symmetries correctly.
+ * @param F The function F
+ * @param partition The partition of F
+ * @param budget The number of nodes each search for an automorphism may expand
+ * @return A new orbit
+ */
+AutomorphismOrbit *computeAutomorphismOrbit(TruthTable *F, Partition *partition, size_t budget);
+
+/**
+ * Free the memory allocated for the orbit
+ * @param orbit The orbit to destroy
+ */
+void destroyAutomorphismOrbit(AutomorphismOrbit *orbit);
+
+#endif //AFFINE_AUTOMORPHISM_H
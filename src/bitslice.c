@@ -0,0 +1,428 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <memory.h>
+#include "structures.h"
+#include "bitslice.h"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/* blockMasks[j] selects the lower half of every block of 2^(j+1) bits in a word */
+static const uint64_t blockMasks[6] = {
+        0x5555555555555555ULL, 0x3333333333333333ULL, 0x0F0F0F0F0F0F0F0FULL,
+        0x00FF00FF00FF00FFULL, 0x0000FFFF0000FFFFULL, 0x00000000FFFFFFFFULL
+};
+
+BitSlicedTruthTable *initBitSlicedTruthTable(size_t n) {
+    BitSlicedTruthTable *F = malloc(sizeof(BitSlicedTruthTable));
+    F->n = n;
+    F->words = n < 6 ? 1 : 1L << (n - 6);
+    F->coordinates = calloc(sizeof(uint64_t), n * F->words);
+    return F;
+}
+
+BitSlicedTruthTable *bitSlice(TruthTable *F) {
+    size_t n = F->n;
+    BitSlicedTruthTable *sliced = initBitSlicedTruthTable(n);
+    size_t inputs = n < 6 ? 1L << n : 64;
+    uint64_t word[MAX_DIMENSION];
+    // The words of the coordinates are collected for 64 inputs at a time, and written once
+    for (size_t w = 0; w < sliced->words; ++w) {
+        memset(word, 0, sizeof(uint64_t) * n);
+        const size_t *elements = F->elements + w * 64;
+        for (size_t x = 0; x < inputs; ++x) {
+            size_t y = elements[x];
+            for (size_t i = 0; i < n; ++i) {
+                word[i] |= (uint64_t) (y >> i & 1) << x;
+            }
+        }
+        for (size_t i = 0; i < n; ++i) {
+            sliced->coordinates[i * sliced->words + w] = word[i];
+        }
+    }
+    return sliced;
+}
+
+TruthTable *unBitSlice(BitSlicedTruthTable *F) {
+    size_t n = F->n;
+    TruthTable *tt = initTruthTable(n);
+    for (size_t x = 0; x < 1L << n; ++x) {
+        size_t y = 0;
+        for (size_t i = 0; i < n; ++i) {
+            y |= (size_t) (F->coordinates[i * F->words + x / 64] >> (x % 64) & 1) << i;
+        }
+        tt->elements[x] = y;
+    }
+    return tt;
+}
+
+void destroyBitSlicedTruthTable(BitSlicedTruthTable *F) {
+    free(F->coordinates);
+    free(F);
+}
+
+/**
+ * Move bit x of a word to bit x + a, for a shift a below 64, by swapping the halves of the blocks selected by a
+ */
+static inline uint64_t shiftWord(uint64_t word, size_t a) {
+    for (size_t j = 0; j < 6; ++j) {
+        if (a >> j & 1) {
+            size_t s = 1L << j;
+            word = ((word & blockMasks[j]) << s) | ((word >> s) & blockMasks[j]);
+        }
+    }
+    return word;
+}
+
+/**
+ * The mask of the inputs that are used in a word, which is all of them unless the dimension is below 6
+ */
+static inline uint64_t usedInputs(size_t n) {
+    return n < 6 ? (1ULL << (1L << n)) - 1 : ~0ULL;
+}
+
+/* When built with -mavx512f or -mavx2, the kernels handle a block of 8 or 4 words, i.e. 512 or 256 inputs, per
+ * instruction. Blocks are aligned on their size, and the words that do not fill a block take the 64-bit path. */
+#if defined(__AVX512F__)
+#define BLOCK_WORDS 8
+typedef __m512i WordBlock;
+
+static inline WordBlock loadBlock(const uint64_t *words) {
+    return _mm512_loadu_si512((const void *) words);
+}
+
+static inline void storeBlock(uint64_t *words, WordBlock block) {
+    _mm512_storeu_si512((void *) words, block);
+}
+
+static inline WordBlock broadcastWord(uint64_t word) {
+    return _mm512_set1_epi64((long long) word);
+}
+
+static inline WordBlock andBlocks(WordBlock a, WordBlock b) {
+    return _mm512_and_si512(a, b);
+}
+
+static inline WordBlock orBlocks(WordBlock a, WordBlock b) {
+    return _mm512_or_si512(a, b);
+}
+
+static inline WordBlock xorBlocks(WordBlock a, WordBlock b) {
+    return _mm512_xor_si512(a, b);
+}
+
+static inline WordBlock shiftBlockLeft(WordBlock block, size_t s) {
+    return _mm512_sll_epi64(block, _mm_cvtsi64_si128((long long) s));
+}
+
+static inline WordBlock shiftBlockRight(WordBlock block, size_t s) {
+    return _mm512_srl_epi64(block, _mm_cvtsi64_si128((long long) s));
+}
+
+/**
+ * Move word l of a block to word l + r, for r below the number of words of a block
+ */
+static inline WordBlock permuteBlock(WordBlock block, size_t r) {
+    long long l = (long long) r;
+    return _mm512_permutexvar_epi64(_mm512_set_epi64(7 ^ l, 6 ^ l, 5 ^ l, 4 ^ l, 3 ^ l, 2 ^ l, 1 ^ l, l), block);
+}
+#elif defined(__AVX2__)
+#define BLOCK_WORDS 4
+typedef __m256i WordBlock;
+
+static inline WordBlock loadBlock(const uint64_t *words) {
+    return _mm256_loadu_si256((const __m256i *) words);
+}
+
+static inline void storeBlock(uint64_t *words, WordBlock block) {
+    _mm256_storeu_si256((__m256i *) words, block);
+}
+
+static inline WordBlock broadcastWord(uint64_t word) {
+    return _mm256_set1_epi64x((long long) word);
+}
+
+static inline WordBlock andBlocks(WordBlock a, WordBlock b) {
+    return _mm256_and_si256(a, b);
+}
+
+static inline WordBlock orBlocks(WordBlock a, WordBlock b) {
+    return _mm256_or_si256(a, b);
+}
+
+static inline WordBlock xorBlocks(WordBlock a, WordBlock b) {
+    return _mm256_xor_si256(a, b);
+}
+
+static inline WordBlock shiftBlockLeft(WordBlock block, size_t s) {
+    return _mm256_sll_epi64(block, _mm_cvtsi64_si128((long long) s));
+}
+
+static inline WordBlock shiftBlockRight(WordBlock block, size_t s) {
+    return _mm256_srl_epi64(block, _mm_cvtsi64_si128((long long) s));
+}
+
+/**
+ * Move word l of a block to word l + r, for r below the number of words of a block. The words are permuted as pairs
+ * of 32-bit halves.
+ */
+static inline WordBlock permuteBlock(WordBlock block, size_t r) {
+    int l = (int) r;
+    return _mm256_permutevar8x32_epi32(block, _mm256_setr_epi32(2 * l, 2 * l + 1, 2 * (1 ^ l), 2 * (1 ^ l) + 1,
+                                                                2 * (2 ^ l), 2 * (2 ^ l) + 1, 2 * (3 ^ l),
+                                                                2 * (3 ^ l) + 1));
+}
+#endif
+
+/**
+ * dest = dest + src, word by word
+ */
+static inline void xorWords(uint64_t *dest, const uint64_t *src, size_t words) {
+    size_t w = 0;
+#if defined(BLOCK_WORDS)
+    for (; w + BLOCK_WORDS <= words; w += BLOCK_WORDS) {
+        storeBlock(dest + w, xorBlocks(loadBlock(dest + w), loadBlock(src + w)));
+    }
+#endif
+    for (; w < words; ++w) {
+        dest[w] ^= src[w];
+    }
+}
+
+void shiftVector(const uint64_t *f, size_t n, size_t a, uint64_t *out) {
+    size_t words = n < 6 ? 1 : 1L << (n - 6);
+    for (size_t w = 0; w < words; ++w) {
+        out[w] = shiftWord(f[w ^ a >> 6], a & 63);
+    }
+}
+
+/**
+ * Word w of the derivative of coordinate i in direction a, plus bit i of c
+ */
+static inline uint64_t derivativeWord(BitSlicedTruthTable *F, size_t i, size_t w, size_t a, size_t c) {
+    const uint64_t *f = F->coordinates + i * F->words;
+    uint64_t word = f[w] ^ shiftWord(f[w ^ a >> 6], a & 63);
+    return c >> i & 1 ? ~word : word;
+}
+
+#if defined(BLOCK_WORDS)
+/**
+ * The block of words starting at word w of the derivative of coordinate i in direction a, plus bit i of c, for w a
+ * multiple of BLOCK_WORDS. The words w + (a >> 6) of f(x + a) lie in one aligned block, in an order given by the low
+ * bits of a >> 6, so they are loaded at once and permuted before their bits are moved as in shiftWord.
+ */
+static inline WordBlock derivativeBlock(BitSlicedTruthTable *F, size_t i, size_t w, size_t a, size_t c) {
+    const uint64_t *f = F->coordinates + i * F->words;
+    size_t r = a >> 6 & (BLOCK_WORDS - 1);
+    WordBlock shifted = loadBlock(f + (w ^ (a >> 6 & ~(size_t) (BLOCK_WORDS - 1))));
+    if (r != 0) shifted = permuteBlock(shifted, r);
+    for (size_t j = 0; j < 6; ++j) {
+        if (a >> j & 1) {
+            size_t s = 1L << j;
+            WordBlock mask = broadcastWord(blockMasks[j]);
+            shifted = orBlocks(shiftBlockLeft(andBlocks(shifted, mask), s),
+                               andBlocks(shiftBlockRight(shifted, s), mask));
+        }
+    }
+    WordBlock block = xorBlocks(loadBlock(f + w), shifted);
+    return c >> i & 1 ? xorBlocks(block, broadcastWord(~0ULL)) : block;
+}
+#endif
+
+size_t countDerivativeSolutions(BitSlicedTruthTable *F, size_t a, size_t c) {
+    size_t n = F->n;
+    uint64_t used = usedInputs(n);
+    size_t count = 0;
+    size_t w = 0;
+#if defined(BLOCK_WORDS)
+    // A coordinate fills whole blocks from dimension 8 or 9 on, and then every input of a word is used
+    for (; w + BLOCK_WORDS <= F->words; w += BLOCK_WORDS) {
+        WordBlock differs = derivativeBlock(F, 0, w, a, c);
+        for (size_t i = 1; i < n; ++i) {
+            differs = orBlocks(differs, derivativeBlock(F, i, w, a, c));
+        }
+        uint64_t words[BLOCK_WORDS];
+        storeBlock(words, differs);
+        for (size_t l = 0; l < BLOCK_WORDS; ++l) {
+            count += __builtin_popcountll(~words[l]);
+        }
+    }
+#endif
+    for (; w < F->words; ++w) {
+        // A bit is set if some coordinate of F(x) + F(x + a) differs from c
+        uint64_t differs = 0;
+        for (size_t i = 0; i < n; ++i) {
+            differs |= derivativeWord(F, i, w, a, c);
+        }
+        count += __builtin_popcountll(~differs & used);
+    }
+    return count;
+}
+
+size_t smallestOrthogonalValue(BitSlicedTruthTable *F, size_t a, size_t c) {
+    size_t n = F->n;
+    size_t words = F->words;
+    uint64_t used = usedInputs(n);
+    uint64_t *rows = malloc(sizeof(uint64_t) * n * words); // Row i is a combination of the coordinate derivatives
+    size_t *combinations = malloc(sizeof(size_t) * n); // The coordinates added up in each row
+    size_t *pivotWords = malloc(sizeof(size_t) * n);
+    uint64_t *pivotBits = malloc(sizeof(uint64_t) * n);
+    size_t *kernel = calloc(sizeof(size_t), n); // kernel[j] is a combination with highest bit j that gives 0
+    size_t rank = 0;
+
+    /* Gaussian elimination on the derivatives of the coordinates: every row that reduces to zero gives a combination
+     * b of coordinates such that b . (F(x) + F(x + a) + c) = 0 */
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t *row = rows + rank * words;
+        size_t first = 0;
+#if defined(BLOCK_WORDS)
+        for (; first + BLOCK_WORDS <= words; first += BLOCK_WORDS) {
+            storeBlock(row + first, derivativeBlock(F, i, first, a, c));
+        }
+#endif
+        for (size_t w = first; w < words; ++w) {
+            row[w] = derivativeWord(F, i, w, a, c) & used;
+        }
+        size_t combination = 1L << i;
+        for (size_t j = 0; j < rank; ++j) {
+            if (row[pivotWords[j]] & pivotBits[j]) {
+                xorWords(row, rows + j * words, words);
+                combination ^= combinations[j];
+            }
+        }
+        size_t w = 0;
+        while (w < words && row[w] == 0) ++w;
+        if (w < words) {
+            pivotWords[rank] = w;
+            pivotBits[rank] = row[w] & -row[w];
+            combinations[rank] = combination;
+            rank += 1;
+            continue;
+        }
+        // Insert the combination in the kernel, keeping distinct highest bits
+        for (size_t j = n; j-- > 0 && combination;) {
+            if (!(combination >> j & 1)) continue;
+            if (kernel[j] == 0) {
+                kernel[j] = combination;
+                break;
+            }
+            combination ^= kernel[j];
+        }
+    }
+
+    /* Every element of the kernel has the highest bit of one of the basis vectors, so the smallest element is the basis
+     * vector with the lowest highest bit */
+    size_t smallest = 0;
+    for (size_t j = 0; j < n && smallest == 0; ++j) {
+        smallest = kernel[j];
+    }
+
+    free(rows);
+    free(combinations);
+    free(pivotWords);
+    free(pivotBits);
+    free(kernel);
+    return smallest;
+}
+
+void moebiusTransform(uint64_t *f, size_t n) {
+    size_t words = n < 6 ? 1 : 1L << (n - 6);
+    // The first 6 variables select bits within a word: every block gets its lower half added to its upper half
+    for (size_t w = 0; w < words; ++w) {
+        for (size_t j = 0; j < 6 && j < n; ++j) {
+            f[w] ^= (f[w] & blockMasks[j]) << (1L << j);
+        }
+    }
+    // The other variables select words, and whole blocks of words are added at once
+    for (size_t half = 1; half < words; half <<= 1) {
+        for (size_t block = 0; block < words; block += 2 * half) {
+            xorWords(f + block + half, f + block, half);
+        }
+    }
+}
+
+/**
+ * Fill atLeast[k] with the bits of a word whose position has weight at least k, for k from 0 to 7
+ */
+static void weightMasks(uint64_t *atLeast) {
+    memset(atLeast, 0, sizeof(uint64_t) * 8);
+    for (size_t p = 0; p < 64; ++p) {
+        for (size_t k = 0; k <= (size_t) __builtin_popcountl(p); ++k) {
+            atLeast[k] |= 1ULL << p;
+        }
+    }
+}
+
+/**
+ * The bits of word w that stand for monomials of degree exactly d: input x is the monomial of the variables in x
+ */
+static inline uint64_t monomialsOfDegree(const uint64_t *atLeast, size_t w, size_t d) {
+    size_t high = __builtin_popcountl(w);
+    if (d < high || d - high > 6) return 0;
+    return atLeast[d - high] & ~atLeast[d - high + 1];
+}
+
+/**
+ * The largest degree of a monomial in an algebraic normal form, 0 if there is none
+ */
+static size_t anfDegree(const uint64_t *anf, size_t words, const uint64_t *atLeast) {
+    size_t degree = 0;
+    for (size_t w = 0; w < words; ++w) {
+        if (anf[w] == 0) continue;
+        size_t k = 6;
+        while (!(anf[w] & atLeast[k])) --k;
+        if (__builtin_popcountl(w) + k > degree) degree = __builtin_popcountl(w) + k;
+    }
+    return degree;
+}
+
+void degreeProfile(BitSlicedTruthTable *F, DegreeProfile *profile) {
+    size_t n = F->n;
+    size_t words = F->words;
+    uint64_t atLeast[8];
+    weightMasks(atLeast);
+    memset(profile, 0, sizeof(DegreeProfile));
+
+    uint64_t *anf = malloc(sizeof(uint64_t) * n * words);
+    memcpy(anf, F->coordinates, sizeof(uint64_t) * n * words);
+    uint64_t **remaining = malloc(sizeof(uint64_t *) * (n + 1)); // The rows that are not a pivot yet
+    for (size_t i = 0; i < n; ++i) {
+        moebiusTransform(anf + i * words, n);
+        profile->coordinateDegrees[i] = anfDegree(anf + i * words, words, atLeast);
+        if (profile->coordinateDegrees[i] > profile->degree) profile->degree = profile->coordinateDegrees[i];
+        remaining[i] = anf + i * words;
+    }
+
+    /* Row i holds the ANF of coordinate i, so the columns are the coefficients of the monomials, and r_d is the rank of
+     * the columns of degree at least d. The pivots are taken among the monomials of the highest degree first: once no
+     * remaining row has a monomial of degree d, the pivots found so far are the rank of the columns of degree >= d. */
+    size_t count = n;
+    size_t rank = 0;
+    for (size_t d = n + 1; d-- > 0;) {
+        for (size_t r = 0; r < count;) {
+            uint64_t *row = remaining[r];
+            size_t w = 0;
+            uint64_t bits = 0;
+            while (w < words && !(bits = row[w] & monomialsOfDegree(atLeast, w, d))) ++w;
+            if (w == words) {
+                ++r;
+                continue;
+            }
+            // The rows before r have no monomial of degree d, so they do not have the pivot either
+            uint64_t pivot = bits & -bits;
+            remaining[r] = remaining[--count];
+            rank += 1;
+            for (size_t s = r; s < count; ++s) {
+                if (remaining[s][w] & pivot) xorWords(remaining[s], row, words);
+            }
+        }
+        profile->ranks[d] = rank;
+    }
+    free(remaining);
+    free(anf);
+}
+
+size_t componentsOfDegree(DegreeProfile *profile, size_t n, size_t d) {
+    return (1L << n) - (1L << (n - profile->ranks[d]));
+}
@@ -0,0 +1,113 @@
+#ifndef AFFINE_BITSLICE_H
+#define AFFINE_BITSLICE_H
+
+#include <stdint.h>
+#include "structures.h"
+
+/**
+ * In bitslice, you will find a second layout for functions: the n coordinate functions of F, each stored as a vector
+ * of 2^n bits. The kernels that look at every input, such as derivatives and dot products, then handle 64 inputs per
+ * word instead of one input per loop iteration.
+ */
+
+/**
+ * A function F stored as its coordinate functions. Bit x of coordinate i is bit i of F(x); the bits of a coordinate
+ * are packed into words of 64 inputs each, input x being bit x % 64 of word x / 64.
+ */
+typedef struct BitSlicedTruthTable {
+    size_t n; // Dimension of the function
+    size_t words; // Number of words per coordinate, 2^n / 64 rounded up
+    uint64_t *coordinates; // Coordinate i is stored in the words [i * words, (i + 1) * words)
+} BitSlicedTruthTable;
+
+/**
+ * Initialize a new bit-sliced truth table where all the elements are zero
+ * @param n The dimension
+ * @return A new bit-sliced truth table
+ */
+BitSlicedTruthTable *initBitSlicedTruthTable(size_t n);
+
+/**
+ * Convert a truth table to the bit-sliced layout
+ * @param F The function F
+ * @return A new bit-sliced truth table of F
+ */
+BitSlicedTruthTable *bitSlice(TruthTable *F);
+
+/**
+ * Convert a bit-sliced truth table back to the element layout
+ * @param F The bit-sliced function F
+ * @return A new truth table of F
+ */
+TruthTable *unBitSlice(BitSlicedTruthTable *F);
+
+/**
+ * Free the memory allocated for the bit-sliced truth table
+ * @param F The bit-sliced truth table to destroy
+ */
+void destroyBitSlicedTruthTable(BitSlicedTruthTable *F);
+
+/**
+ * Compute the vector of f(x + a) from the vector of a Boolean function f
+ * @param f The vector of f
+ * @param n The dimension
+ * @param a The shift
+ * @param out The vector of f(x + a), which must not overlap f
+ */
+void shiftVector(const uint64_t *f, size_t n, size_t a, uint64_t *out);
+
+/**
+ * Count the inputs x where the derivative F(x) + F(x + a) in direction a is equal to c
+ * @param F The bit-sliced function F
+ * @param a The direction
+ * @param c The value
+ * @return The number of solutions x of F(x) + F(x + a) = c
+ */
+size_t countDerivativeSolutions(BitSlicedTruthTable *F, size_t a, size_t c);
+
+/**
+ * Find the smallest nonzero b such that b . (F(x) + F(x + a) + c) = 0 for all x, i.e. the smallest nonzero combination
+ * of coordinates of F that is constant on the derivative in direction a.
+ * @param F The bit-sliced function F
+ * @param a The direction
+ * @param c The constant
+ * @return The smallest such b, or 0 if there is none
+ */
+size_t smallestOrthogonalValue(BitSlicedTruthTable *F, size_t a, size_t c);
+
+/**
+ * The degrees of the components b . F of a function F. Let r_d be the rank of the coefficients, as vectors of F_2^n,
+ * of the monomials of degree at least d in the algebraic normal form of F: the component b . F has degree at least d
+ * unless b is orthogonal to all of them, so 2^n - 2^(n - r_d) components have degree at least d.
+ */
+typedef struct DegreeProfile {
+    size_t degree; // The algebraic degree of F, 0 if F is constant
+    size_t coordinateDegrees[MAX_DIMENSION]; // The algebraic degree of each coordinate function of F
+    size_t ranks[MAX_DIMENSION + 2]; // ranks[d] is r_d for d from 0 to n, and 0 above n
+} DegreeProfile;
+
+/**
+ * Replace the vector of a Boolean function f by the vector of its algebraic normal form, in place (Moebius transform)
+ * @param f The vector of f, of 2^n bits
+ * @param n The dimension
+ */
+void moebiusTransform(uint64_t *f, size_t n);
+
+/**
+ * Compute the degree profile of F from the algebraic normal forms of its coordinates, in O(n^2 * 2^n / 64) word
+ * operations
+ * @param F The bit-sliced function F
+ * @param profile The degree profile of F
+ */
+void degreeProfile(BitSlicedTruthTable *F, DegreeProfile *profile);
+
+/**
+ * The number of components b . F, b nonzero, of degree at least d
+ * @param profile The degree profile of F
+ * @param n The dimension of F
+ * @param d The degree, from 1 to n
+ * @return The number of components of degree at least d
+ */
+size_t componentsOfDegree(DegreeProfile *profile, size_t n, size_t d);
+
+#endif //AFFINE_BITSLICE_H
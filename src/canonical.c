@@ -0,0 +1,183 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <memory.h>
+#include "structures.h"
+#include "equivalence.h"
+#include "permutation.h"
+#include "canonical.h"
+
+/**
+ * The state of the search for the smallest representative
+ */
+typedef struct CanonicalSearch {
+    size_t n; // Dimension
+    TruthTable *F; // The function we are searching the class of
+    size_t *multiplicities; // multiplicities[y] is the number of pre-images of y under F
+    PartialLinearMap *L1; // The outer permutation, defined on the values of F seen so far
+    size_t *L2; // L2[x] for the inputs x that are set so far
+    bool *inSpan; // inSpan[x] is true if x is a value of L2 set so far
+    size_t *values; // The representative R(x) of the current branch
+    size_t *classes; // The multiplicities m(x) of the current branch
+    size_t *bestValues; // The best representative found so far
+    size_t *bestClasses; // The multiplicities of the best representative
+    bool haveBest; // True once a representative has been found
+    size_t updates; // Number of times the best representative was replaced
+} CanonicalSearch;
+
+static CanonicalSearch *initCanonicalSearch(size_t n) {
+    CanonicalSearch *search = malloc(sizeof(CanonicalSearch));
+    search->n = n;
+    search->F = NULL;
+    search->multiplicities = malloc(sizeof(size_t) * 1L << n);
+    search->L1 = initPartialLinearMap(n);
+    search->L2 = malloc(sizeof(size_t) * 1L << n);
+    search->inSpan = calloc(sizeof(bool), 1L << n);
+    search->values = malloc(sizeof(size_t) * 1L << n);
+    search->classes = malloc(sizeof(size_t) * 1L << n);
+    search->bestValues = malloc(sizeof(size_t) * 1L << n);
+    search->bestClasses = malloc(sizeof(size_t) * 1L << n);
+    search->haveBest = false;
+    search->updates = 0;
+    return search;
+}
+
+static void destroyCanonicalSearch(CanonicalSearch *search) {
+    free(search->multiplicities);
+    destroyPartialLinearMap(search->L1);
+    free(search->L2);
+    free(search->inSpan);
+    free(search->values);
+    free(search->classes);
+    free(search->bestValues);
+    free(search->bestClasses);
+    free(search);
+}
+
+/**
+ * Guess L2 on the basis element 2^k, which sets R(x) for all x in [2^k, 2^(k+1)).
+ * @param bounded True if the representative so far is equal to the best one, so it has to be compared, false if it is
+ * already smaller or if there is no best representative yet
+ */
+static void guessCanonicalBasis(CanonicalSearch *search, size_t k, bool bounded) {
+    size_t n = search->n;
+    if (k == n) {
+        if (!bounded) {
+            memcpy(search->bestValues, search->values, sizeof(size_t) * 1L << n);
+            memcpy(search->bestClasses, search->classes, sizeof(size_t) * 1L << n);
+            search->haveBest = true;
+            search->updates += 1;
+        }
+        return;
+    }
+    size_t *F = search->F->elements;
+    size_t *multiplicities = search->multiplicities;
+    PartialLinearMap *L1 = search->L1;
+
+    // m(2^k) is compared first, so the image of 2^k must come from the bucket with the smallest multiplicity
+    size_t smallest = SIZE_MAX;
+    for (size_t v = 1; v < 1L << n; ++v) {
+        if (!search->inSpan[v] && multiplicities[F[v]] < smallest) smallest = multiplicities[F[v]];
+    }
+
+    size_t block = 1L << k;
+    for (size_t v = 1; v < 1L << n; ++v) {
+        if (search->inSpan[v] || multiplicities[F[v]] != smallest) continue;
+        size_t countL1 = L1->count;
+        bool equal = bounded;
+        bool larger = false;
+        for (size_t x = block; x < 2 * block; ++x) {
+            size_t input = v ^ search->L2[x ^ block];
+            size_t y = F[input];
+            search->L2[x] = input;
+            // The smallest choice of L1 maps a new independent value to the next power of two
+            if (!L1->known[y]) addPoint(L1, y, L1->count);
+            search->values[x] = L1->values[y];
+            search->classes[x] = multiplicities[y];
+            if (equal) {
+                size_t m = search->classes[x], r = search->values[x];
+                size_t bestM = search->bestClasses[x], bestR = search->bestValues[x];
+                if (m > bestM || (m == bestM && r > bestR)) {
+                    larger = true;
+                    break;
+                }
+                if (m < bestM || r < bestR) equal = false;
+            }
+        }
+        if (!larger) {
+            for (size_t x = block; x < 2 * block; ++x) search->inSpan[search->L2[x]] = true;
+            size_t updates = search->updates;
+            guessCanonicalBasis(search, k + 1, equal);
+            for (size_t x = block; x < 2 * block; ++x) search->inSpan[search->L2[x]] = false;
+            // The best representative now shares its prefix with this branch, so the next guesses are compared to it
+            if (search->updates != updates) bounded = true;
+        }
+        resetPoints(L1, countL1);
+    }
+}
+
+/**
+ * Search the linear representatives of F, keeping the best representative of the search if it is smaller
+ */
+static void searchCanonicalForm(CanonicalSearch *search, TruthTable *F) {
+    size_t n = search->n;
+    search->F = F;
+    memset(search->multiplicities, 0, sizeof(size_t) * 1L << n);
+    countElements(F, search->multiplicities);
+    resetPoints(search->L1, 1);
+
+    // R(0) = L1(F(0)), where L1 maps F(0) to 1 if it is not 0
+    size_t y = F->elements[0];
+    if (y != 0) addPoint(search->L1, y, 1);
+    search->L2[0] = 0;
+    search->inSpan[0] = true;
+    search->values[0] = search->L1->values[y];
+    search->classes[0] = search->multiplicities[y];
+    bool bounded = search->haveBest;
+    if (bounded) {
+        size_t m = search->classes[0], r = search->values[0];
+        if (m > search->bestClasses[0] || (m == search->bestClasses[0] && r > search->bestValues[0])) return;
+        bounded = m == search->bestClasses[0] && r == search->bestValues[0];
+    }
+    guessCanonicalBasis(search, 0, bounded);
+}
+
+TruthTable *linearCanonicalForm(TruthTable *F) {
+    size_t n = F->n;
+    CanonicalSearch *search = initCanonicalSearch(n);
+    searchCanonicalForm(search, F);
+
+    TruthTable *representative = initTruthTable(n);
+    memcpy(representative->elements, search->bestValues, sizeof(size_t) * 1L << n);
+    destroyCanonicalSearch(search);
+    return representative;
+}
+
+TruthTable *affineCanonicalForm(TruthTable *F) {
+    size_t n = F->n;
+    CanonicalSearch *search = initCanonicalSearch(n);
+    size_t *multiplicities = calloc(sizeof(size_t), 1L << n);
+    countElements(F, multiplicities);
+
+    /* The affine representative has R(0) = 0, and m(0) is the multiplicity of F(a) for the constant a of A2, so only
+     * the constants in the bucket with the smallest multiplicity are searched */
+    size_t smallest = SIZE_MAX;
+    for (size_t a = 0; a < 1L << n; ++a) {
+        if (multiplicities[F->elements[a]] < smallest) smallest = multiplicities[F->elements[a]];
+    }
+    TruthTable *Fa = initTruthTable(n); // F(x + a) + F(a)
+    for (size_t a = 0; a < 1L << n; ++a) {
+        if (multiplicities[F->elements[a]] != smallest) continue;
+        for (size_t x = 0; x < 1L << n; ++x) {
+            Fa->elements[x] = F->elements[x ^ a] ^ F->elements[a];
+        }
+        searchCanonicalForm(search, Fa);
+    }
+
+    TruthTable *representative = initTruthTable(n);
+    memcpy(representative->elements, search->bestValues, sizeof(size_t) * 1L << n);
+    destroyTruthTable(Fa);
+    free(multiplicities);
+    destroyCanonicalSearch(search);
+    return representative;
+}
@@ -0,0 +1,35 @@
+#ifndef AFFINE_CANONICAL_H
+#define AFFINE_CANONICAL_H
+
+#include "structures.h"
+
+/**
+ * In canonical, you will find the computation of canonical representatives of linear and affine equivalence classes.
+ * Two functions are equivalent exactly when their representatives are equal, so a collection of functions can be
+ * classified by computing one representative per function and comparing hashes, instead of running a search for
+ * every pair.
+ *
+ * The representative of F is the function R = L1 * F * L2 in the class of F that is smallest when the pairs
+ * (m(x), R(x)) are compared in lexicographic order for x = 0, 1, 2, ..., where m(x) is the number of pre-images of
+ * R(x) under R. The multiplicities do not depend on L1, so the basis images of L2 are guessed from the bucket of the
+ * smallest multiplicity, as in the search for L1. Given L2, the smallest L1 maps every new independent value of F to
+ * the next power of two, so only L2 is searched, and branches that are larger than the best representative so far
+ * are cut.
+ */
+
+/**
+ * Compute the canonical representative of the linear equivalence class of F
+ * @param F The function F
+ * @return A new truth table with the representative of the class of F
+ */
+TruthTable *linearCanonicalForm(TruthTable *F);
+
+/**
+ * Compute the canonical representative of the affine equivalence class of F. The representative is the smallest of the
+ * linear representatives of F(x + a) + F(a), taken over the constants a where F(a) has the fewest pre-images.
+ * @param F The function F
+ * @return A new truth table with the representative of the class of F
+ */
+TruthTable *affineCanonicalForm(TruthTable *F);
+
+#endif //AFFINE_CANONICAL_H
@@ -0,0 +1,146 @@
+#include <time.h>
+#include <stdlib.h>
+#include <memory.h>
+#include "structures.h"
+#include "equivalence.h"
+#include "canonical.h"
+#include "prefetch.h"
+
+/**
+ * The number of functions read ahead of the search by default
+ */
+#define DEFAULT_PREFETCH_DEPTH 4
+
+/**
+ * Print out a list over all the flags that can be used in the program
+ */
+void printClassifyHelp();
+
+/**
+ * Check if two truth tables are equal
+ */
+static bool equalTruthTables(TruthTable *F, TruthTable *G) {
+    return F->n == G->n && memcmp(F->elements, G->elements, sizeof(size_t) * 1L << F->n) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    RunTimes *runTime;
+    bool times = false;
+    bool affine = true;
+    size_t prefetchDepth = DEFAULT_PREFETCH_DEPTH;
+    clock_t startTotalTime;
+
+    // Check for flags
+    if (argc < 2) {
+        printClassifyHelp();
+        return 0;
+    }
+    startTotalTime = clock();
+    runTime = initRunTimes();
+
+    char **files = malloc(sizeof(char *) * argc);
+    size_t count = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-') {
+            switch (argv[i][1]) {
+                case 'h':
+                    printClassifyHelp();
+                    return 0;
+                case 't':
+                    times = true;
+                    continue;
+                case 'a':
+                    affine = true;
+                    continue;
+                case 'l':
+                    affine = false;
+                    continue;
+                case 'p':
+                    if (i + 1 < argc) {
+                        prefetchDepth = strtoul(argv[++i], NULL, 10);
+                        continue;
+                    }
+                    printf("Missing number of functions to read ahead, -p\n");
+                    return 1;
+                default:
+                    printf("Unknown flag, %s\n", argv[i]);
+                    return 1;
+            }
+        }
+        files[count++] = argv[i];
+    }
+
+    /* One representative per function, then a hash join on the representatives: the table maps a hash to the first
+     * function of its class, and collisions are resolved by comparing the representatives */
+    size_t capacity = 1;
+    while (capacity < 2 * count) capacity <<= 1;
+    size_t *table = malloc(sizeof(size_t) * capacity); // Index of the first function of a class, or count if empty
+    for (size_t i = 0; i < capacity; ++i) table[i] = count;
+    TruthTable **representatives = malloc(sizeof(TruthTable *) * count);
+    size_t *classOf = malloc(sizeof(size_t) * count); // The first function of the class of each function
+    size_t *next = malloc(sizeof(size_t) * count); // The next function in the same class, or count if it is the last
+    size_t *last = malloc(sizeof(size_t) * count); // The last function of the class, for the first function of a class
+    size_t numClasses = 0;
+
+    // The next files are read and parsed on another thread while the representative of the current one is searched
+    InputPrefetch *prefetch = initInputPrefetch(files, count, prefetchDepth);
+    for (size_t i = 0; i < count; ++i) {
+        TruthTable *F = nextPrefetchedInput(prefetch);
+        representatives[i] = affine ? affineCanonicalForm(F) : linearCanonicalForm(F);
+        destroyTruthTable(F);
+        unsigned long long hash = hashTruthTable(14695981039346656037ULL, representatives[i]);
+        printf("%016llx %s\n", hash, files[i]);
+
+        size_t slot = hash & (capacity - 1);
+        while (table[slot] != count && !equalTruthTables(representatives[table[slot]], representatives[i])) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (table[slot] == count) {
+            table[slot] = i;
+            numClasses += 1;
+        } else {
+            next[last[table[slot]]] = i;
+        }
+        classOf[i] = table[slot];
+        last[classOf[i]] = i;
+        next[i] = count;
+    }
+    destroyInputPrefetch(prefetch);
+
+    printf("\n%zu classes\n", numClasses);
+    for (size_t i = 0; i < count; ++i) {
+        if (classOf[i] != i) continue;
+        printf("%s", files[i]);
+        for (size_t j = next[i]; j != count; j = next[j]) printf(" %s", files[j]);
+        printf("\n");
+    }
+
+    for (size_t i = 0; i < count; ++i) destroyTruthTable(representatives[i]);
+    free(representatives);
+    free(classOf);
+    free(next);
+    free(last);
+    free(table);
+    free(files);
+    runTime->total = stopTime(runTime->total, startTotalTime);
+    if (times) {
+        printTimes(runTime);
+    }
+    destroyRunTimes(runTime);
+    return 0;
+}
+
+void printClassifyHelp() {
+    printf("Classification\n");
+    printf("Sort functions into equivalence classes by computing the canonical representative of each function.\n");
+    printf("Usage: classify [classify_options] [filename ...] \n");
+    printf("Classify_options:\n");
+    printf("\t-h \t- Print help\n");
+    printf("\t-t \t- Print run time\n");
+    printf("\t-a \t- Classify up to affine equivalence (default)\n");
+    printf("\t-l \t- Classify up to linear equivalence\n");
+    printf("\t-p count \t- Read up to count functions ahead, on another thread (default %d, 0 to read when needed)\n",
+           DEFAULT_PREFETCH_DEPTH);
+    printf("\n");
+    printf("\tfilename = the path to file of a function\n");
+}
@@ -0,0 +1,671 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "control.h"
+#include "equivalence.h"
+
+#define DEFAULT_CHECKPOINT_INTERVAL 60.0
+#define NODES_BETWEEN_CLOCK_CHECKS 16
+#define SAMPLED_CONSTANTS 16
+
+/* Set by the signal handler, polled by the search */
+static volatile sig_atomic_t receivedSignal = 0;
+
+static void handleSignal(int signal) {
+    receivedSignal = signal;
+}
+
+/**
+ * Read the monotonic clock
+ * @return The current time in seconds
+ */
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+SearchControl *initSearchControl() {
+    SearchControl *control = malloc(sizeof(SearchControl));
+    control->n = 0;
+    control->c1 = 0;
+    control->depth = 0;
+    control->icks = NULL;
+    control->images = NULL;
+    control->resuming = false;
+    control->resumeC1 = 0;
+    control->resumeDepth = 0;
+    control->resumeIcks = NULL;
+    control->resumeDirection = DIRECTION_OUTER;
+    control->timeout = 0;
+    control->deadline = 0;
+    control->checkpointInterval = DEFAULT_CHECKPOINT_INTERVAL;
+    control->lastCheckpoint = 0;
+    control->periodicCheckpoints = false;
+    control->checkpointFile = NULL;
+    control->resumeFile = NULL;
+    control->stage = NULL;
+    control->resumeStage[0] = '\0';
+    control->constants = 1;
+    control->shardIndex = 0;
+    control->shardCount = 1;
+    control->shardChoices = 1;
+    control->symmetryBreaking = false;
+    control->lookahead = 0;
+    control->direction = DIRECTION_AUTO;
+    control->walkDirection = DIRECTION_OUTER;
+    control->estimateProbes = 0;
+    memset(&control->estimate, 0, sizeof(TreeEstimate));
+    control->topChoices = 0;
+    control->progressInterval = 0;
+    control->lastProgress = 0;
+    control->stageStarted = 0;
+    control->stageStartFraction = 0;
+    control->threads = 0;
+    control->portfolio = 1;
+    control->memoryLimit = 0;
+    control->resultFormat = RESULTS_TEXT;
+    control->resultsFile = NULL;
+    control->storeFile = NULL;
+    control->strategy = BASIS_STANDARD;
+    control->seed = 0;
+    control->race = NULL;
+    control->sweepPool = NULL;
+    control->muted = false;
+    control->L1 = NULL;
+    control->L2 = NULL;
+    control->query = 0;
+    control->nodes = 0;
+    control->status = SEARCH_RUNNING;
+    return control;
+}
+
+bool parseControlFlag(SearchControl *control, int argc, char *argv[], int *i) {
+    char *flag = argv[*i];
+    if (strcmp(flag, "--timeout") == 0 && *i + 1 < argc) {
+        control->timeout = strtod(argv[++*i], NULL);
+        return true;
+    }
+    if (strcmp(flag, "--checkpoint") == 0 && *i + 1 < argc) {
+        control->checkpointFile = argv[++*i];
+        control->periodicCheckpoints = true;
+        return true;
+    }
+    if (strcmp(flag, "--checkpoint-interval") == 0 && *i + 1 < argc) {
+        control->checkpointInterval = strtod(argv[++*i], NULL);
+        control->periodicCheckpoints = true;
+        return true;
+    }
+    if (strcmp(flag, "--resume") == 0 && *i + 1 < argc) {
+        control->resumeFile = argv[++*i];
+        return true;
+    }
+    if (strcmp(flag, "--symmetry") == 0) {
+        control->symmetryBreaking = true;
+        return true;
+    }
+    if (strcmp(flag, "--lookahead") == 0 && *i + 1 < argc) {
+        control->lookahead = strtoul(argv[++*i], NULL, 10);
+        return true;
+    }
+    if (strcmp(flag, "--direction") == 0 && *i + 1 < argc) {
+        char *direction = argv[++*i];
+        if (strcmp(direction, "auto") == 0) {
+            control->direction = DIRECTION_AUTO;
+        } else if (strcmp(direction, "outer") == 0) {
+            control->direction = DIRECTION_OUTER;
+        } else if (strcmp(direction, "inner") == 0) {
+            control->direction = DIRECTION_INNER;
+        } else {
+            printf("Invalid direction, %s, expected auto, outer or inner\n", direction);
+            exit(1);
+        }
+        return true;
+    }
+    if (strcmp(flag, "--estimate") == 0 && *i + 1 < argc) {
+        control->estimateProbes = strtoul(argv[++*i], NULL, 10);
+        return true;
+    }
+    if (strcmp(flag, "--progress") == 0 && *i + 1 < argc) {
+        control->progressInterval = strtod(argv[++*i], NULL);
+        return true;
+    }
+    if (strcmp(flag, "--threads") == 0 && *i + 1 < argc) {
+        control->threads = strtoul(argv[++*i], NULL, 10);
+        return true;
+    }
+    if (strcmp(flag, "--portfolio") == 0 && *i + 1 < argc) {
+        control->portfolio = strtoul(argv[++*i], NULL, 10);
+        if (control->portfolio == 0) control->portfolio = 1;
+        return true;
+    }
+    if (strcmp(flag, "--memory") == 0 && *i + 1 < argc) {
+        control->memoryLimit = strtoul(argv[++*i], NULL, 10) << 20;
+        return true;
+    }
+    if (strcmp(flag, "--results") == 0 && *i + 1 < argc) {
+        char *format = argv[++*i];
+        if (strcmp(format, "text") == 0) {
+            control->resultFormat = RESULTS_TEXT;
+        } else if (strcmp(format, "json") == 0) {
+            control->resultFormat = RESULTS_JSON;
+        } else if (strcmp(format, "binary") == 0) {
+            control->resultFormat = RESULTS_BINARY;
+        } else {
+            printf("Invalid results format, %s, expected text, json or binary\n", format);
+            exit(1);
+        }
+        return true;
+    }
+    if (strcmp(flag, "--results-file") == 0 && *i + 1 < argc) {
+        control->resultsFile = argv[++*i];
+        return true;
+    }
+    if (strcmp(flag, "--store") == 0 && *i + 1 < argc) {
+        control->storeFile = argv[++*i];
+        return true;
+    }
+    if (strcmp(flag, "--shard") == 0 && *i + 1 < argc) {
+        if (sscanf(argv[++*i], "%zu/%zu", &control->shardIndex, &control->shardCount) != 2 ||
+            control->shardIndex >= control->shardCount) {
+            printf("Invalid shard, %s, expected i/N with 0 <= i < N\n", argv[*i]);
+            exit(1);
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Load the frontier from the resume file. The search is then walked down the restored path before it continues.
+ */
+static void loadCheckpoint(SearchControl *control) {
+    FILE *fp = fopen(control->resumeFile, "r");
+    if (fp == NULL) {
+        printf("Checkpoint, %s, not found, starting from scratch\n", control->resumeFile);
+        return;
+    }
+    unsigned long long query;
+    size_t n, depth;
+    char direction[16];
+    if (fscanf(fp, "checkpoint 2\nquery %llx\nn %zu\nstage %63s\ndirection %15s\nc1 %zu\ndepth %zu\n", &query, &n,
+               control->resumeStage, direction, &control->resumeC1, &depth) != 6 || depth > control->n ||
+        (strcmp(direction, "outer") != 0 && strcmp(direction, "inner") != 0)) {
+        printf("Checkpoint, %s, is malformed\n", control->resumeFile);
+        fclose(fp);
+        exit(1);
+    }
+    if (query != control->query || n != control->n) {
+        printf("Checkpoint, %s, belongs to another query\n", control->resumeFile);
+        fclose(fp);
+        exit(1);
+    }
+    /* The positions of the frontier are positions in the buckets of the walk that wrote them, so the stage resumes in
+     * that walk instead of choosing again, and a walk forced the other way cannot resume it */
+    control->resumeDirection = strcmp(direction, "inner") == 0 ? DIRECTION_INNER : DIRECTION_OUTER;
+    if (control->direction != DIRECTION_AUTO && control->direction != control->resumeDirection) {
+        printf("Checkpoint, %s, was written by the %s walk, which conflicts with --direction\n", control->resumeFile,
+               direction);
+        fclose(fp);
+        exit(1);
+    }
+    for (size_t k = 0; k < depth; ++k) {
+        fscanf(fp, "%zu", &control->resumeIcks[k]);
+    }
+    fclose(fp);
+    control->resumeDepth = depth;
+    control->resuming = true;
+}
+
+/**
+ * Create a copy of the path of a checkpoint file. When the search is sharded, the index of the shard is appended.
+ */
+static char *shardPath(SearchControl *control, const char *path) {
+    if (path == NULL) return NULL;
+    size_t length = strlen(path) + 32;
+    char *result = malloc(length);
+    if (control->shardCount > 1) {
+        snprintf(result, length, "%s.%zu", path, control->shardIndex);
+    } else {
+        snprintf(result, length, "%s", path);
+    }
+    return result;
+}
+
+/**
+ * A rough bound on the bytes a query of dimension n takes: the tables of F and G, their orthoderivatives, partitions
+ * and bit-sliced forms, then per search of the portfolio the span and the restricted domains of the leaves, and per
+ * thread the domains of an inner search. Every table has 2^n entries of 8 bytes, except the t-sets of F kept for the
+ * lookahead, which take 2^n bits per entry.
+ */
+static size_t queryMemory(size_t n, size_t threads, size_t portfolio, size_t lookahead) {
+    size_t perEntry = 256 + portfolio * (96 + 32 * n + (lookahead > 0 ? 1L << n >> 3 : 0)) + threads * 16 * n;
+    return perEntry << n;
+}
+
+/**
+ * Cut down the threads and the portfolio until the query fits in the memory budget, or refuse the query
+ */
+static void fitMemoryBudget(SearchControl *control) {
+    size_t budget = control->memoryLimit;
+    if (budget == 0) {
+        long pages = sysconf(_SC_PHYS_PAGES);
+        long pageSize = sysconf(_SC_PAGESIZE);
+        if (pages <= 0 || pageSize <= 0) return;
+        budget = (size_t) pages * (size_t) pageSize;
+    }
+    size_t threads = control->threads;
+    size_t portfolio = control->portfolio;
+    if (control->lookahead > 0 && queryMemory(control->n, threads, portfolio, control->lookahead) > budget) {
+        printf("Memory: the lookahead is turned off to stay within %zu MB\n", budget >> 20);
+        control->lookahead = 0;
+    }
+    size_t lookahead = control->lookahead;
+    while (queryMemory(control->n, threads, portfolio, lookahead) > budget && (threads > 1 || portfolio > 1)) {
+        if (portfolio >= threads) {
+            portfolio = (portfolio + 1) / 2;
+        } else {
+            threads = (threads + 1) / 2;
+        }
+    }
+    size_t needed = queryMemory(control->n, threads, portfolio, lookahead);
+    if (needed > budget) {
+        printf("The query needs about %zu MB, more than the memory budget of %zu MB\n", needed >> 20, budget >> 20);
+        exit(SEARCH_UNDECIDED);
+    }
+    if (threads != control->threads || portfolio != control->portfolio) {
+        printf("Memory: %zu threads and a portfolio of %zu to stay within %zu MB\n", threads, portfolio, budget >> 20);
+        control->threads = threads;
+        control->portfolio = portfolio;
+    }
+}
+
+void startSearchControl(SearchControl *control, const char *tool, TruthTable *F, TruthTable *G) {
+    size_t n = F->n;
+    control->n = n;
+    control->icks = calloc(sizeof(size_t), n + 1);
+    control->images = calloc(sizeof(size_t), n + 1);
+    control->resumeIcks = calloc(sizeof(size_t), n + 1);
+
+    unsigned long long hash = 14695981039346656037ULL;
+    for (const char *c = tool; *c; ++c) {
+        hash ^= (unsigned char) *c;
+        hash *= 1099511628211ULL;
+    }
+    hash = hashTruthTable(hash, F);
+    hash = hashTruthTable(hash, G);
+    // The basis decides the order of the frontier, so checkpoints of other strategies are not interchangeable either
+    hash ^= control->strategy;
+    hash *= 1099511628211ULL;
+    if (control->strategy == BASIS_RANDOM) {
+        hash ^= control->seed;
+        hash *= 1099511628211ULL;
+    }
+    // Each shard explores a different part of the search space, so its checkpoints are not interchangeable
+    hash ^= control->shardIndex;
+    hash *= 1099511628211ULL;
+    hash ^= control->shardCount;
+    control->query = hash * 1099511628211ULL;
+
+    if (control->threads == 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        control->threads = processors > 0 ? (size_t) processors : 1;
+    }
+
+    // The searches of a portfolio are at different places of the search space, so there is no single frontier to save
+    if (control->portfolio > 1 &&
+        (control->resumeFile != NULL || control->periodicCheckpoints || control->shardCount > 1)) {
+        printf("A portfolio cannot be combined with checkpoints or shards\n");
+        exit(1);
+    }
+    // An estimate only walks a few random paths, so racing strategies gains nothing
+    if (control->estimateProbes > 0) control->portfolio = 1;
+    fitMemoryBudget(control);
+
+    /* A checkpoint is flushed when the search is stopped, but only to a path that was given: without --checkpoint we
+     * reuse the resume file, and without either no checkpoint is written. */
+    if (control->checkpointFile == NULL) {
+        control->checkpointFile = control->resumeFile;
+    }
+    // Shards of the same query usually share their arguments, so each shard gets its own checkpoint file
+    control->checkpointFile = shardPath(control, control->checkpointFile);
+    control->resumeFile = shardPath(control, control->resumeFile);
+    if (control->resumeFile != NULL) {
+        loadCheckpoint(control);
+    }
+
+    // Only text results can share standard output with the messages; JSON lines or binary records would be mixed up
+    if (control->resultFormat != RESULTS_TEXT && control->resultsFile == NULL) {
+        printf("JSON and binary results need a file, --results-file\n");
+        exit(1);
+    }
+    control->resultsFile = shardPath(control, control->resultsFile);
+    if (!openResultSink(control->resultFormat, control->resultsFile)) {
+        printf("Cannot write the results to %s\n", control->resultsFile);
+        exit(1);
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handleSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    double start = now();
+    control->deadline = control->timeout > 0 ? start + control->timeout : 0;
+    control->lastCheckpoint = start;
+    control->lastProgress = start;
+}
+
+/**
+ * Find the first constant of the slice of this process, and the number of constants in the slice
+ */
+static size_t sliceOfConstants(SearchControl *control, size_t *count) {
+    size_t first = (size_t) ((unsigned long long) control->shardIndex * control->constants / control->shardCount);
+    size_t last = (size_t) ((unsigned long long) (control->shardIndex + 1) * control->constants / control->shardCount);
+    *count = last > first ? last - first : 1;
+    return first;
+}
+
+/**
+ * Estimate the fraction of the slice of this process that has been searched, from the current constant and the
+ * position of the top-level choice in its bucket
+ */
+static double searchedFraction(SearchControl *control) {
+    size_t count;
+    size_t first = sliceOfConstants(control, &count);
+    double position = (double) control->c1 - (double) first;
+    if (control->depth > 0 && control->topChoices > 0) {
+        position += (double) control->icks[0] / (double) control->topChoices;
+    }
+    if (position < 0) return 0;
+    return position >= (double) count ? 1 : position / (double) count;
+}
+
+/**
+ * Print the fraction of the slice that has been searched, the time spent on the stage, and the expected time left,
+ * extrapolated from the progress made since the stage started
+ */
+static void printProgress(SearchControl *control, double current) {
+    double fraction = searchedFraction(control);
+    double elapsed = current - control->stageStarted;
+    double progress = fraction - control->stageStartFraction;
+    fprintf(stderr, "Progress: %s, constant %zu of %zu, %.1f%% done, %.0f s elapsed", control->stage, control->c1,
+            control->constants, 100 * fraction, elapsed);
+    if (progress > 0) {
+        fprintf(stderr, ", ETA %.0f s", elapsed * (1 - fraction) / progress);
+    }
+    fprintf(stderr, "\n");
+}
+
+bool beginSearchStage(SearchControl *control, const char *stage, size_t constants) {
+    if (control->status != SEARCH_RUNNING) return false;
+    if (control->resuming && strcmp(control->resumeStage, stage) != 0) {
+        // The checkpoint was written by a later stage, so this stage already completed without success
+        return false;
+    }
+    control->stage = stage;
+    control->constants = constants;
+    // With more shards than constants, the top-level choices of each constant are split as well
+    control->shardChoices = (control->shardCount + constants - 1) / constants;
+    control->c1 = control->resuming ? control->resumeC1 : 0;
+    control->depth = 0;
+    memset(&control->estimate, 0, sizeof(TreeEstimate));
+    control->stageStarted = now();
+    control->stageStartFraction = searchedFraction(control);
+    return true;
+}
+
+bool resumesStage(SearchControl *control, const char *stage) {
+    return control->resuming && strcmp(control->resumeStage, stage) == 0;
+}
+
+/**
+ * Find out if the search was asked to stop from the outside, without changing the search control
+ * @return SEARCH_INTERRUPTED if another search of the portfolio finished first or a signal was received,
+ * SEARCH_TIMED_OUT if the clock is read and the time budget ran out, SEARCH_RUNNING otherwise
+ */
+static SearchStatus stopReason(SearchControl *control, bool readClock) {
+    if (control->race != NULL) {
+        SearchControl *winner = __atomic_load_n(&control->race->winner, __ATOMIC_ACQUIRE);
+        if (winner != NULL && winner != control) return SEARCH_INTERRUPTED;
+    }
+    if (receivedSignal) return SEARCH_INTERRUPTED;
+    if (readClock && control->deadline > 0 && now() >= control->deadline) return SEARCH_TIMED_OUT;
+    return SEARCH_RUNNING;
+}
+
+bool searchStopRequested(SearchControl *control) {
+    return stopReason(control, true) != SEARCH_RUNNING;
+}
+
+bool searchShouldStopNow(SearchControl *control) {
+    control->nodes = NODES_BETWEEN_CLOCK_CHECKS;
+    return searchShouldStop(control);
+}
+
+bool searchShouldStop(SearchControl *control) {
+    if (control->status != SEARCH_RUNNING) return true;
+    bool readClock = ++control->nodes >= NODES_BETWEEN_CLOCK_CHECKS;
+    SearchStatus reason = stopReason(control, readClock);
+    if (reason != SEARCH_RUNNING) {
+        control->status = reason;
+        return true;
+    }
+    if (!readClock) return false;
+    control->nodes = 0;
+
+    double current = now();
+    if (control->periodicCheckpoints && current - control->lastCheckpoint >= control->checkpointInterval) {
+        writeCheckpoint(control);
+        control->lastCheckpoint = current;
+    }
+    if (control->progressInterval > 0 && current - control->lastProgress >= control->progressInterval) {
+        printProgress(control, current);
+        control->lastProgress = current;
+    }
+    return false;
+}
+
+size_t resumePosition(SearchControl *control, size_t k) {
+    if (!control->resuming) return 0;
+    if (k < control->resumeDepth) return control->resumeIcks[k];
+    // We reached the node that was being expanded when the checkpoint was written; explore it from the start.
+    control->resuming = false;
+    return 0;
+}
+
+/**
+ * Find the shard owning a unit of the search space. The units are numbered constant by constant, and shard i owns
+ * the units u with floor(u * N / units) = i.
+ */
+static size_t shardOfUnit(SearchControl *control, size_t unit) {
+    unsigned long long units = (unsigned long long) control->constants * control->shardChoices;
+    return (size_t) ((unsigned long long) unit * control->shardCount / units);
+}
+
+bool shardOwnsConstant(SearchControl *control, size_t c1) {
+    if (control->shardCount == 1) return true;
+    size_t first = shardOfUnit(control, c1 * control->shardChoices);
+    size_t last = shardOfUnit(control, c1 * control->shardChoices + control->shardChoices - 1);
+    return first <= control->shardIndex && control->shardIndex <= last;
+}
+
+bool shardOwnsChoice(SearchControl *control, size_t ick) {
+    if (control->shardChoices == 1) return true;
+    return shardOfUnit(control, control->c1 * control->shardChoices + ick % control->shardChoices) ==
+           control->shardIndex;
+}
+
+bool sampledConstant(SearchControl *control, size_t c1) {
+    if (control->estimateProbes == 0) return true;
+    size_t count;
+    size_t first = sliceOfConstants(control, &count);
+    size_t step = count > SAMPLED_CONSTANTS ? count / SAMPLED_CONSTANTS : 1;
+    return c1 >= first && (c1 - first) % step == 0 && (c1 - first) / step < SAMPLED_CONSTANTS;
+}
+
+void reportEstimate(SearchControl *control) {
+    if (control->status != SEARCH_RUNNING) return;
+    TreeEstimate *estimate = &control->estimate;
+    size_t count;
+    sliceOfConstants(control, &count);
+    size_t sampled = estimate->constants > 0 ? estimate->constants : 1;
+    printf("Estimate: %s, %.3g nodes, %.3g leaves and %.3g s per constant, over %zu sampled constants\n",
+           control->stage, estimate->nodes / sampled, estimate->leaves / sampled, estimate->seconds / sampled,
+           estimate->constants);
+    printf("Estimate: %.3g s for the %zu constants of the search\n", estimate->seconds / sampled * count, count);
+    control->status = SEARCH_ESTIMATED;
+}
+
+void recordEquivalence(SearchControl *control, TruthTable *L1, TruthTable *L2) {
+    if (control->L1 != NULL) destroyTruthTable(control->L1);
+    if (control->L2 != NULL) destroyTruthTable(control->L2);
+    control->L1 = L1;
+    control->L2 = L2;
+}
+
+SearchControl *forkSearchControl(SearchControl *control, BasisStrategy strategy, unsigned int seed,
+                                 SearchRace *race) {
+    SearchControl *fork = malloc(sizeof(SearchControl));
+    memcpy(fork, control, sizeof(SearchControl));
+    fork->icks = calloc(sizeof(size_t), control->n + 1);
+    fork->images = calloc(sizeof(size_t), control->n + 1);
+    fork->resumeIcks = calloc(sizeof(size_t), control->n + 1);
+    fork->resuming = false;
+    fork->checkpointFile = NULL;
+    fork->resumeFile = NULL;
+    fork->resultsFile = NULL;
+    fork->periodicCheckpoints = false;
+    fork->portfolio = 1;
+    fork->strategy = strategy;
+    fork->seed = seed;
+    fork->race = race;
+    fork->sweepPool = NULL;
+    fork->nodes = 0;
+    fork->L1 = NULL;
+    fork->L2 = NULL;
+    // The progress of the first search stands for the progress of the portfolio
+    if (strategy != BASIS_STANDARD) fork->progressInterval = 0;
+    return fork;
+}
+
+bool winRace(SearchControl *control) {
+    SearchRace *race = control->race;
+    if (race == NULL) return true;
+    pthread_mutex_lock(&race->lock);
+    if (race->winner == NULL) {
+        __atomic_store_n(&race->winner, control, __ATOMIC_RELEASE);
+    }
+    bool won = race->winner == control;
+    pthread_mutex_unlock(&race->lock);
+    return won;
+}
+
+const char *basisStrategyName(BasisStrategy strategy) {
+    switch (strategy) {
+        case BASIS_STANDARD:
+            return "standard basis";
+        case BASIS_SMALLEST_BUCKET:
+            return "smallest bucket first";
+        case BASIS_RANDOM:
+            return "random basis";
+    }
+    return "unknown";
+}
+
+void writeCheckpoint(SearchControl *control) {
+    if (control->checkpointFile == NULL) return;
+
+    // Write to a temporary file first, so that a crash while writing never destroys the previous checkpoint.
+    size_t length = strlen(control->checkpointFile) + 5;
+    char *temporary = malloc(length);
+    snprintf(temporary, length, "%s.tmp", control->checkpointFile);
+    FILE *fp = fopen(temporary, "w");
+    if (fp == NULL) {
+        printf("Could not write checkpoint, %s\n", temporary);
+        free(temporary);
+        return;
+    }
+    fprintf(fp, "checkpoint 2\nquery %llx\nn %zu\nstage %s\ndirection %s\nc1 %zu\ndepth %zu\n", control->query,
+            control->n, control->stage ? control->stage : "none",
+            control->walkDirection == DIRECTION_INNER ? "inner" : "outer", control->c1, control->depth);
+    for (size_t k = 0; k < control->depth; ++k) {
+        fprintf(fp, k < control->depth - 1 ? "%zu " : "%zu", control->icks[k]);
+    }
+    fprintf(fp, "\nimages");
+    for (size_t k = 0; k < control->depth; ++k) {
+        fprintf(fp, " %zu", control->images[k]);
+    }
+    fprintf(fp, "\n");
+    fclose(fp);
+    rename(temporary, control->checkpointFile);
+    free(temporary);
+}
+
+SearchStatus finishSearchControl(SearchControl *control, bool found) {
+    if (control->status == SEARCH_RUNNING) {
+        control->status = found ? SEARCH_FOUND : SEARCH_EXHAUSTED;
+    }
+    switch (control->status) {
+        case SEARCH_TIMED_OUT:
+        case SEARCH_INTERRUPTED:
+            writeCheckpoint(control);
+            printf(control->status == SEARCH_TIMED_OUT ? "Timed out" : "Interrupted");
+            if (control->checkpointFile != NULL) {
+                printf(", checkpoint written to %s", control->checkpointFile);
+            }
+            printf("\n");
+            break;
+        case SEARCH_UNDECIDED:
+            printf("Undecided, no engine applies to this query\n");
+            break;
+        case SEARCH_ESTIMATED:
+            // Nothing was searched, so a checkpoint being resumed is still valid
+            break;
+        default:
+            // The search is complete, the checkpoint is of no use anymore
+            if (control->checkpointFile != NULL) {
+                remove(control->checkpointFile);
+            }
+            break;
+    }
+    closeResultSink();
+    return control->status;
+}
+
+void destroySearchControl(SearchControl *control) {
+    recordEquivalence(control, NULL, NULL);
+    destroySweepPool(control->sweepPool);
+    free(control->icks);
+    free(control->images);
+    free(control->resumeIcks);
+    free(control->checkpointFile);
+    free(control->resumeFile);
+    free(control->resultsFile);
+    free(control);
+}
+
+void printControlHelp() {
+    printf("\t--timeout s \t- Stop after s seconds\n");
+    printf("\t--checkpoint file \t- Write the search state to file periodically and when the search stops\n");
+    printf("\t--checkpoint-interval s \t- Seconds between two checkpoints (default 60)\n");
+    printf("\t--resume file \t- Resume the search from the checkpoint in file\n");
+    printf("\t--shard i/N \t- Only search slice i of N of the search space\n");
+    printf("\t--symmetry \t- Use the automorphisms of F to skip symmetric branches\n");
+    printf("\t--lookahead d \t- Check for an inner permutation at the last d depths above the leaves\n");
+    printf("\t--direction d \t- Guess the outer or the inner permutation first, or choose automatically (default)\n");
+    printf("\t--estimate p \t- Only estimate the size of the search, from p random probes per constant\n");
+    printf("\t--progress s \t- Print the progress and the expected time left every s seconds\n");
+    printf("\t--portfolio k \t- Race k searches with different basis orders on k threads, or in turns on one thread\n");
+    printf("\t--threads t \t- Use t threads for the preprocessing and the inner search (default: one per processor)\n");
+    printf("\t--memory m \t- Keep the query within m MB (default: the physical memory)\n");
+    printf("\t--results f \t- Write the maps found as text (default), json lines or binary records\n");
+    printf("\t--results-file file \t- Write the maps found to file instead of the standard output\n");
+    printf("\t--store file \t- Share the preparation of F with other processes through file, e.g. in /dev/shm\n");
+}
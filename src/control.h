@@ -0,0 +1,309 @@
+#ifndef AFFINE_CONTROL_H
+#define AFFINE_CONTROL_H
+
+#include <stdbool.h>
+#include <signal.h>
+#include <pthread.h>
+#include "structures.h"
+#include "output.h"
+
+/**
+ * In control, you will find everything needed to steer a long running search from the outside: time budgets,
+ * cancellation through SIGINT/SIGTERM, and checkpoints that allow a search to be resumed where it stopped.
+ */
+
+/**
+ * The outcome of a search. The values are used as the exit status of the programs.
+ */
+typedef enum SearchStatus {
+    SEARCH_FOUND = 0, // An equivalence was found
+    SEARCH_EXHAUSTED = 1, // The whole search space was explored without finding an equivalence
+    SEARCH_TIMED_OUT = 2, // The time budget ran out before the search was done
+    SEARCH_INTERRUPTED = 3, // The search was stopped by SIGINT or SIGTERM
+    SEARCH_UNDECIDED = 4, // No engine could decide the query
+    SEARCH_RUNNING = 5, // The search has not finished yet
+    SEARCH_ESTIMATED = 6 // Only the size of the search tree was estimated
+} SearchStatus;
+
+/**
+ * An estimate of the size of the search tree of guessValuesOfL for one constant, averaged over random probes
+ */
+typedef struct TreeEstimate {
+    double nodes; // Estimated number of nodes
+    double leaves; // Estimated number of leaves, i.e. outer permutations that are checked for an inner permutation
+    double seconds; // Estimated run time in seconds
+    size_t constants; // Number of constants the estimate was summed over
+} TreeEstimate;
+
+/**
+ * The order in which the basis elements are guessed. The search visits the same tree for every basis, but the order of
+ * the basis decides how early contradictions are found, so the run time of a hard query varies a lot between bases.
+ */
+typedef enum BasisStrategy {
+    BASIS_STANDARD, // The standard basis {1, 2, 4, ...}
+    BASIS_SMALLEST_BUCKET, // Basis elements taken from the smallest buckets of the partition of F first
+    BASIS_RANDOM // A random basis, drawn from the seed of the search
+} BasisStrategy;
+
+/**
+ * Which of the two permutations the tree walk guesses. Guessing L1 branches over the buckets of the values of F,
+ * guessing L2 over the buckets of its inputs, and the smaller of the two trees depends on the functions.
+ */
+typedef enum SearchDirection {
+    DIRECTION_AUTO, // Guess the permutation whose walk is estimated to take the less time
+    DIRECTION_OUTER, // Guess the outer permutation L1, and search for L2 at the leaves
+    DIRECTION_INNER // Guess the inner permutation L2, and derive L1 along the way
+} SearchDirection;
+
+/**
+ * The threads that search the constants c2 of the leaves of one search, defined in equivalence
+ */
+typedef struct SweepPool SweepPool;
+
+/**
+ * Shared by the searches of a portfolio, which race each other on separate threads. The first search to finish wins,
+ * and the others stop at their next check.
+ */
+typedef struct SearchRace {
+    pthread_mutex_t lock; // Taken to declare the winner
+    // The search that finished first, NULL while all of them are running; written under the lock, read atomically
+    struct SearchControl *winner;
+} SearchRace;
+
+/**
+ * Holds the explicit frontier of the search together with the settings for time budgets and checkpoints.
+ * The frontier of the search is the current constant c1, and for each depth of guessValuesOfL the position in the
+ * bucket of G (ick) and the image of the basis element that was guessed.
+ */
+typedef struct SearchControl {
+    size_t n; // Dimension of the functions
+    const char *stage; // Name of the search stage currently running
+    char resumeStage[64]; // Name of the search stage to resume
+    size_t c1; // The constant c1 currently searched
+    size_t depth; // Depth of the node in guessValuesOfL currently expanded
+    size_t *icks; // Position in the bucket of G chosen at each depth
+    size_t *images; // Image of the basis element chosen at each depth
+    bool resuming; // True while the search is walking down the path restored from a checkpoint
+    size_t resumeC1; // The constant c1 to resume from
+    size_t resumeDepth; // Number of depths restored from the checkpoint
+    size_t *resumeIcks; // Positions in the buckets of G to resume from
+    SearchDirection resumeDirection; // The permutation guessed first by the stage to resume
+    double timeout; // Time budget in seconds, 0 means no budget
+    double deadline; // Point in time when the budget runs out
+    double checkpointInterval; // Seconds between two periodic checkpoints
+    double lastCheckpoint; // Point in time when the last checkpoint was written
+    bool periodicCheckpoints; // True if checkpoints should be written periodically
+    char *checkpointFile; // Path to the checkpoint file, NULL if no checkpoint should be written
+    char *resumeFile; // Path to the checkpoint file to resume from, NULL if the search starts from scratch
+    size_t constants; // Number of constants c1 that are searched, 1 for a linear search
+    size_t shardIndex; // Index i of the slice of the search space this process explores
+    size_t shardCount; // Number N of slices the search space is split into, 1 if the search is not sharded
+    size_t shardChoices; // Number of slices the top-level choices of each constant are split into
+    bool symmetryBreaking; // True if the automorphisms of F should be used to skip symmetric branches
+    size_t lookahead; // Number of depths above the leaves where a partial L1 is checked for an L2, 0 for none
+    SearchDirection direction; // Which permutation the linear searches guess first
+    SearchDirection walkDirection; // The permutation the current stage guesses first, outer or inner
+    size_t estimateProbes; // Number of random probes per constant when estimating the search, 0 to search
+    TreeEstimate estimate; // Sum of the estimates of the constants sampled so far
+    size_t topChoices; // Number of top-level choices of the current constant, for the progress report
+    double progressInterval; // Seconds between two progress reports, 0 means no reports
+    double lastProgress; // Point in time when the last progress report was printed
+    double stageStarted; // Point in time when the current stage started
+    double stageStartFraction; // Fraction of the slice that was done when the current stage started
+    size_t threads; // Number of threads for the parts of a query that run in parallel, 0 for one per processor
+    size_t portfolio; // Number of searches raced on separate threads, 1 for a single search
+    size_t memoryLimit; // Number of bytes the query may use, 0 for the physical memory of the machine
+    ResultFormat resultFormat; // How the maps and constants that are found are written
+    char *resultsFile; // The file the results are written to, NULL for standard output
+    const char *storeFile; // The store that the prepared function F is shared through, NULL for none
+    BasisStrategy strategy; // The order in which the basis elements are guessed
+    unsigned int seed; // Seed of the random basis
+    SearchRace *race; // The race this search takes part in, NULL if it is not part of a portfolio
+    bool muted; // True if an equivalence found is only recorded, not written, e.g. while the search is a filter
+    SweepPool *sweepPool; // The threads searching the constants c2 of the leaves, NULL until the first leaf
+    TruthTable *L1; // The outer permutation of the equivalence found, NULL if none was found
+    TruthTable *L2; // The inner permutation of the equivalence found, NULL if none was found
+    unsigned long long query; // Hash identifying the query, used to detect checkpoints of another query
+    size_t nodes; // Number of nodes expanded since the clock was last checked
+    SearchStatus status; // The status of the search
+} SearchControl;
+
+/**
+ * Initialize a new SearchControl with no time budget and no checkpoints. The frontier is allocated once the
+ * dimension is known, in startSearchControl.
+ * @return A new SearchControl
+ */
+SearchControl *initSearchControl();
+
+/**
+ * Parse a long flag (--timeout, --checkpoint, --checkpoint-interval, --resume, --shard, --symmetry, --estimate,
+ * --progress, --portfolio, --threads, --memory, --results, --results-file, --store,
+ * --lookahead) belonging to the search control.
+ * @param control The search control to configure
+ * @param argc Number of arguments
+ * @param argv The arguments
+ * @param i Position of the flag, moved past its value if the flag takes one
+ * @return True if the flag was recognized, false otherwise
+ */
+bool parseControlFlag(SearchControl *control, int argc, char *argv[], int *i);
+
+/**
+ * Allocate the frontier, start the clock, install the signal handlers and load the checkpoint to resume from, if any.
+ * The number of threads is fixed here as well, if it was left to the number of processors. If the memory the query
+ * needs is above the memory budget, the lookahead is turned off and the threads and the portfolio are cut down until
+ * it fits, and if it still does not fit, the query is refused with the status UNDECIDED before anything large is
+ * allocated.
+ * @param control The search control
+ * @param tool Name of the program, part of the query identifier
+ * @param F The function F
+ * @param G The function G
+ */
+void startSearchControl(SearchControl *control, const char *tool, TruthTable *F, TruthTable *G);
+
+/**
+ * Begin a stage of the search, e.g. the search over the orthoderivatives. A query may run several stages one after
+ * another; when resuming, the stages before the one that wrote the checkpoint are skipped, since they completed.
+ * @param control The search control
+ * @param stage Name of the stage
+ * @param constants Number of constants c1 that are searched by the stage, 1 for a linear search
+ * @return True if the stage has to run, false if it can be skipped
+ */
+bool beginSearchStage(SearchControl *control, const char *stage, size_t constants);
+
+/**
+ * Check if the search resumes from a checkpoint written by the given stage.
+ * @param control The search control
+ * @param stage Name of the stage
+ * @return True if the checkpoint being resumed was written by the stage
+ */
+bool resumesStage(SearchControl *control, const char *stage);
+
+/**
+ * Check if the search has to stop, either because the time budget ran out or because a signal was received.
+ * Periodic checkpoints are also written from here. The clock is only read every few calls.
+ * @param control The search control
+ * @return True if the search should unwind
+ */
+bool searchShouldStop(SearchControl *control);
+
+/**
+ * Check if the search has to stop like searchShouldStop, but read the clock right away. This is meant for the end of a
+ * long step, such as the check of a leaf, that was cut short because the search was asked to stop.
+ * @param control The search control
+ * @return True if the search should unwind
+ */
+bool searchShouldStopNow(SearchControl *control);
+
+/**
+ * Check if the search was asked to stop, by the time budget, a signal or another search of the portfolio, without
+ * changing the search control. The threads that help a search, and the long steps that run between two calls of
+ * searchShouldStop, poll this; the search itself then stops at its next call of searchShouldStop.
+ * @param control The search control
+ * @return True if the search was asked to stop
+ */
+bool searchStopRequested(SearchControl *control);
+
+/**
+ * Find the position in the bucket of G to start from at the given depth. When resuming, this is the position
+ * restored from the checkpoint, otherwise 0.
+ * @param control The search control
+ * @param k The depth
+ * @return The first position to try
+ */
+size_t resumePosition(SearchControl *control, size_t k);
+
+/**
+ * Check if the slice of this process contains any part of the search for the constant c1.
+ * The search space is cut into units: each constant c1, and when there are more shards than constants, each class of
+ * top-level choices (ick modulo shardChoices) of that constant. Shard i owns a contiguous range of the units.
+ * @param control The search control
+ * @param c1 The constant
+ * @return True if the constant has to be searched by this process
+ */
+bool shardOwnsConstant(SearchControl *control, size_t c1);
+
+/**
+ * Check if the slice of this process contains the top-level choice ick for the current constant.
+ * @param control The search control
+ * @param ick Position in the bucket of G chosen for the first basis element
+ * @return True if the choice has to be explored by this process
+ */
+bool shardOwnsChoice(SearchControl *control, size_t ick);
+
+/**
+ * Check if the constant c1 is one of the constants sampled when estimating the search. The samples are spread evenly
+ * over the constants, and every constant is sampled when the search is not estimated.
+ * @param control The search control
+ * @param c1 The constant
+ * @return True if the constant has to be searched or estimated
+ */
+bool sampledConstant(SearchControl *control, size_t c1);
+
+/**
+ * Print the estimate of the current stage, extrapolated from the sampled constants to all the constants of the slice,
+ * and stop the search with the status SEARCH_ESTIMATED.
+ * @param control The search control
+ */
+void reportEstimate(SearchControl *control);
+
+/**
+ * Keep the equivalence L1 * F * L2 = G found by the search, for the stages that post-process it
+ * @param control The search control, which takes over the truth tables
+ * @param L1 The outer permutation
+ * @param L2 The inner permutation
+ */
+void recordEquivalence(SearchControl *control, TruthTable *L1, TruthTable *L2);
+
+/**
+ * Create a copy of a started search control for one search of a portfolio. The copy has its own frontier, shares the
+ * time budget, and never writes checkpoints.
+ * @param control The search control of the query
+ * @param strategy The order in which the copy guesses the basis elements
+ * @param seed Seed of the random basis
+ * @param race The race the copy takes part in
+ * @return A new search control
+ */
+SearchControl *forkSearchControl(SearchControl *control, BasisStrategy strategy, unsigned int seed, SearchRace *race);
+
+/**
+ * Try to be the first search of the portfolio to finish, either with an equivalence or with the whole search space
+ * explored. Only the winner may print its result.
+ * @param control The search control
+ * @return True if the search won the race, or if it is not part of a portfolio
+ */
+bool winRace(SearchControl *control);
+
+/**
+ * Get the name of a basis strategy, as reported when it wins a race
+ * @param strategy The strategy
+ * @return The name of the strategy
+ */
+const char *basisStrategyName(BasisStrategy strategy);
+
+/**
+ * Write the current frontier of the search to the checkpoint file.
+ * @param control The search control
+ */
+void writeCheckpoint(SearchControl *control);
+
+/**
+ * Finish the search: report the status, flush the checkpoint if the search was stopped, and remove it if the search
+ * completed.
+ * @param control The search control
+ * @param found True if an equivalence was found
+ * @return The status of the search, to be used as exit status
+ */
+SearchStatus finishSearchControl(SearchControl *control, bool found);
+
+/**
+ * Free the memory allocated for the search control
+ * @param control The search control to destroy
+ */
+void destroySearchControl(SearchControl *control);
+
+/**
+ * Print the flags belonging to the search control
+ */
+void printControlHelp();
+
+#endif //AFFINE_CONTROL_H
@@ -0,0 +1,204 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "control.h"
+
+/**
+ * A small local coordinator for sharded searches. It launches the shards of one query as processes, each with its
+ * output redirected to its own file, and collects their results. The first shard that finds an equivalence wins;
+ * the remaining shards are then terminated.
+ */
+
+/**
+ * Print out a list over all the flags that can be used in the program
+ */
+void printCoordinatorHelp();
+
+/* Set by the signal handler, the shards are then terminated and get the chance to write their checkpoints */
+static volatile sig_atomic_t receivedSignal = 0;
+
+static void handleSignal(int signal) {
+    receivedSignal = signal;
+}
+
+/**
+ * Send SIGTERM to all shards that are still running
+ */
+static void terminateShards(pid_t *pids, size_t shards) {
+    for (size_t i = 0; i < shards; ++i) {
+        if (pids[i] > 0) kill(pids[i], SIGTERM);
+    }
+}
+
+/**
+ * Copy the output of a shard to the console
+ */
+static void printShardOutput(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) return;
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        fwrite(buffer, 1, read, stdout);
+    }
+    fclose(fp);
+}
+
+int main(int argc, char *argv[]) {
+    size_t shards = 2;
+    char *directory = ".";
+    int first = 1;
+
+    // Loop over the flags given to the coordinator, everything from the program on is passed to the shards
+    for (; first < argc && argv[first][0] == '-'; ++first) {
+        switch (argv[first][1]) {
+            case 'h':
+                printCoordinatorHelp();
+                return 0;
+            case 'j':
+                if (first + 1 < argc) shards = strtoul(argv[++first], NULL, 10);
+                continue;
+            case 'd':
+                if (first + 1 < argc) directory = argv[++first];
+                continue;
+            default:
+                printf("Unknown flag, %s\n", argv[first]);
+                return 1;
+        }
+    }
+    if (first >= argc || shards == 0) {
+        printCoordinatorHelp();
+        return 1;
+    }
+
+    // The arguments of each shard: the program, --shard i/N, and then the arguments given to the coordinator
+    int shardArgc = argc - first + 2;
+    char **shardArgv = malloc(sizeof(char *) * (shardArgc + 1));
+    shardArgv[0] = argv[first];
+    shardArgv[1] = "--shard";
+    for (int i = first + 1; i < argc; ++i) {
+        shardArgv[i - first + 2] = argv[i];
+    }
+    shardArgv[shardArgc] = NULL;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handleSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    pid_t *pids = malloc(sizeof(pid_t) * shards);
+    char **outputs = malloc(sizeof(char *) * shards);
+    for (size_t i = 0; i < shards; ++i) {
+        size_t length = strlen(directory) + 64;
+        outputs[i] = malloc(length);
+        snprintf(outputs[i], length, "%s/shard.%zu.out", directory, i);
+
+        char shard[64];
+        snprintf(shard, sizeof(shard), "%zu/%zu", i, shards);
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            int fd = open(outputs[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                printf("Could not open %s\n", outputs[i]);
+                _exit(127);
+            }
+            dup2(fd, STDOUT_FILENO);
+            close(fd);
+            shardArgv[2] = shard;
+            execvp(shardArgv[0], shardArgv);
+            printf("Could not start %s\n", shardArgv[0]);
+            _exit(127);
+        }
+        if (pids[i] < 0) {
+            printf("Could not start shard %zu\n", i);
+            terminateShards(pids, i);
+            return 1;
+        }
+    }
+
+    /* Collect the results. The status of the coordinator is the status of the winning shard, otherwise the most
+     * severe status among the shards: a shard that did not finish means the query is undecided, and so does a shard
+     * that no engine applies to. */
+    SearchStatus result = SEARCH_EXHAUSTED;
+    size_t running = shards;
+    size_t winner = shards;
+    bool terminated = false;
+    while (running > 0) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                if (receivedSignal && !terminated) {
+                    terminateShards(pids, shards);
+                    terminated = true;
+                }
+                continue;
+            }
+            break;
+        }
+        size_t i = 0;
+        while (i < shards && pids[i] != pid) ++i;
+        if (i == shards) continue;
+        pids[i] = 0;
+        running -= 1;
+
+        int exitStatus = WIFEXITED(status) ? WEXITSTATUS(status) : SEARCH_INTERRUPTED;
+        if (exitStatus == SEARCH_FOUND && winner == shards) {
+            winner = i;
+            result = SEARCH_FOUND;
+            terminateShards(pids, shards);
+            terminated = true;
+        } else if (winner == shards && exitStatus != SEARCH_EXHAUSTED) {
+            // An undecided shard ran out of engines rather than time, which any unfinished shard outranks
+            if (exitStatus == SEARCH_UNDECIDED) {
+                printf("Shard %zu could not decide the query, see %s\n", i, outputs[i]);
+                if (result == SEARCH_EXHAUSTED) result = SEARCH_UNDECIDED;
+            } else if (exitStatus == SEARCH_TIMED_OUT || exitStatus == SEARCH_INTERRUPTED) {
+                if (result != SEARCH_INTERRUPTED) result = exitStatus;
+            } else {
+                printf("Shard %zu failed with status %d, see %s\n", i, exitStatus, outputs[i]);
+                result = SEARCH_INTERRUPTED;
+            }
+        }
+    }
+
+    if (winner < shards) {
+        printf("Shard %zu/%zu found an equivalence:\n", winner, shards);
+        printShardOutput(outputs[winner]);
+    } else if (result == SEARCH_EXHAUSTED) {
+        printf("No shard found an equivalence\n");
+    } else if (result == SEARCH_UNDECIDED) {
+        printf("No shard could decide the query, the query is undecided\n");
+    } else {
+        printf("Not all shards finished, the query is undecided\n");
+    }
+
+    for (size_t i = 0; i < shards; ++i) {
+        free(outputs[i]);
+    }
+    free(outputs);
+    free(pids);
+    free(shardArgv);
+    return result;
+}
+
+void printCoordinatorHelp() {
+    printf("Coordinator\n");
+    printf("Run one query as several shards in parallel, and stop all shards on the first success.\n");
+    printf("Usage: coordinator [coordinator_options] [program] [program_options] [filenameF] [filenameG] \n");
+    printf("Coordinator_options:\n");
+    printf("\t-h \t- Print help\n");
+    printf("\t-j N \t- Number of shards to launch (default 2)\n");
+    printf("\t-d dir \t- Directory for the output of the shards (default .)\n");
+    printf("\n");
+    printf("\tprogram = the program to shard, e.g. ./ea_orthoderivative\n");
+    printf("\tThe output of shard i is written to dir/shard.i.out\n");
+}
@@ -0,0 +1,984 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory.h>
+#include <pthread.h>
+#include "structures.h"
+#include "equivalence.h"
+#include "orthoderivative.h"
+#include "permutation.h"
+#include "bitslice.h"
+#include "taskgraph.h"
+#include "output.h"
+#include "dispatch.h"
+#include "store.h"
+
+/**
+ * Check if a quadratic function F is APN, i.e. if every derivative F(x) + F(x + a) + F(a) + F(0), which is linear,
+ * has a kernel of size 2. Being linear, each derivative is given by its values on the standard basis, and its kernel
+ * has size 2 exactly when these values have rank n - 1; this takes O(n^2) per direction rather than O(2^n).
+ */
+static bool isQuadraticApn(TruthTable *F) {
+    size_t *elements = F->elements;
+    size_t n = F->n;
+    for (size_t a = 1; a < 1L << n; ++a) {
+        // Reduce the images of the basis vectors against each other, keeping one vector per leading bit
+        size_t pivots[sizeof(size_t) * 8] = {0};
+        size_t rank = 0;
+        for (size_t i = 0; i < n; ++i) {
+            size_t image = elements[a ^ 1L << i] ^ elements[1L << i] ^ elements[a] ^ elements[0];
+            for (size_t bit = n; bit-- > 0 && image;) {
+                if (!(image >> bit & 1)) continue;
+                if (!pivots[bit]) {
+                    pivots[bit] = image;
+                    ++rank;
+                }
+                image ^= pivots[bit];
+            }
+        }
+        if (rank != n - 1) return false;
+    }
+    return true;
+}
+
+PreparedFunction *prepareFunction(TruthTable *F) {
+    PreparedFunction *prepared = malloc(sizeof(PreparedFunction));
+    prepared->function = F;
+    prepared->permutation = isPermutation(F);
+    BitSlicedTruthTable *sliced = bitSlice(F);
+    degreeProfile(sliced, &prepared->degrees);
+    prepared->degree = prepared->degrees.degree;
+    prepared->quadraticApn = prepared->degree == 2 && isQuadraticApn(F);
+    destroyBitSlicedTruthTable(sliced);
+    prepared->orthoderivativeComputed = false;
+    prepared->orthoderivative = NULL;
+    prepared->partition = NULL;
+    prepared->orthoderivativePartition = NULL;
+    prepared->inputPartition = NULL;
+    prepared->orthoderivativeInputPartition = NULL;
+    prepared->orbit = NULL;
+    prepared->orthoderivativeOrbit = NULL;
+    prepared->store = NULL;
+    return prepared;
+}
+
+TruthTable *preparedOrthoderivative(PreparedFunction *F) {
+    if (!F->orthoderivativeComputed) {
+        F->orthoderivative = findOrthoderivative(F->function);
+        F->orthoderivativeComputed = true;
+    }
+    return F->orthoderivative;
+}
+
+Partition *preparedPartition(PreparedFunction *F) {
+    if (F->partition == NULL) {
+        F->partition = partitionTt(F->function);
+    }
+    return F->partition;
+}
+
+Partition *preparedOrthoderivativePartition(PreparedFunction *F) {
+    if (F->orthoderivativePartition == NULL) {
+        F->orthoderivativePartition = partitionTt(preparedOrthoderivative(F));
+    }
+    return F->orthoderivativePartition;
+}
+
+Partition *preparedInputPartition(PreparedFunction *F) {
+    if (F->inputPartition == NULL) {
+        F->inputPartition = partitionInputs(F->function);
+    }
+    return F->inputPartition;
+}
+
+Partition *preparedOrthoderivativeInputPartition(PreparedFunction *F) {
+    if (F->orthoderivativeInputPartition == NULL) {
+        F->orthoderivativeInputPartition = partitionInputs(preparedOrthoderivative(F));
+    }
+    return F->orthoderivativeInputPartition;
+}
+
+/**
+ * The computation of the orthoderivative of a prepared function, split into ranges of directions
+ */
+typedef struct OrthoderivativeJob {
+    PreparedFunction *F; // The prepared function
+    SearchControl *control; // Polled by the ranges, so that a stop request cancels the computation
+    BitSlicedTruthTable *sliced; // The bit-sliced truth table of the function
+    TruthTable *od; // The orthoderivative being computed
+    struct OrthoderivativeRange *ranges; // The ranges of directions
+    size_t numRanges; // Number of ranges of directions
+} OrthoderivativeJob;
+
+/**
+ * A range of directions of an orthoderivative, computed by one task
+ */
+typedef struct OrthoderivativeRange {
+    OrthoderivativeJob *job; // The computation the range belongs to
+    size_t first; // The first direction of the range
+    size_t last; // The direction after the last one of the range
+    bool exists; // False if some direction of the range has no orthogonal value
+} OrthoderivativeRange;
+
+static void sliceTask(void *argument) {
+    OrthoderivativeJob *job = argument;
+    job->sliced = bitSlice(job->F->function);
+}
+
+static void orthoderivativeRangeTask(void *argument) {
+    OrthoderivativeRange *range = argument;
+    OrthoderivativeJob *job = range->job;
+    range->exists = orthoderivativeRange(job->F->function, job->sliced, range->first, range->last, job->od,
+                                         job->control);
+}
+
+static void orthoderivativeDoneTask(void *argument) {
+    OrthoderivativeJob *job = argument;
+    bool exists = true;
+    for (size_t i = 0; i < job->numRanges; ++i) {
+        exists = exists && job->ranges[i].exists;
+    }
+    destroyBitSlicedTruthTable(job->sliced);
+    if (!exists) destroyTruthTable(job->od);
+    // A cancelled computation leaves the orthoderivative not computed, rather than computed and missing
+    if (!exists && searchStopRequested(job->control)) return;
+    job->F->orthoderivative = exists ? job->od : NULL;
+    job->F->orthoderivativeComputed = true;
+}
+
+static void orthoderivativePartitionTask(void *argument) {
+    PreparedFunction *F = argument;
+    if (F->orthoderivativeComputed && F->orthoderivative != NULL) preparedOrthoderivativePartition(F);
+}
+
+static void partitionTask(void *argument) {
+    preparedPartition(argument);
+}
+
+/**
+ * Add the tasks computing the orthoderivative of F and its partition to the graph: the bit-sliced function, the
+ * ranges of directions, which all wait for it, and the partition, which waits for all the ranges.
+ */
+static void addOrthoderivativeTasks(TaskGraph *graph, OrthoderivativeJob *job, PreparedFunction *F,
+                                    SearchControl *control) {
+    size_t entries = 1L << F->function->n;
+    job->F = F;
+    job->control = control;
+    job->od = initTruthTable(F->function->n);
+    // A few ranges per thread balance the load, but a range should not be too short to be worth a task
+    job->numRanges = graph->threads > 1 ? 4 * graph->threads : 1;
+    if (job->numRanges > entries / 16) job->numRanges = entries / 16 ? entries / 16 : 1;
+    job->ranges = malloc(sizeof(OrthoderivativeRange) * job->numRanges);
+
+    Task *slice = addTask(graph, sliceTask, job);
+    Task *done = addTask(graph, orthoderivativeDoneTask, job);
+    for (size_t i = 0; i < job->numRanges; ++i) {
+        job->ranges[i].job = job;
+        job->ranges[i].first = entries * i / job->numRanges;
+        job->ranges[i].last = entries * (i + 1) / job->numRanges;
+        Task *range = addTask(graph, orthoderivativeRangeTask, &job->ranges[i]);
+        addDependency(range, slice);
+        addDependency(done, range);
+    }
+    addDependency(addTask(graph, orthoderivativePartitionTask, F), done);
+}
+
+void prepareQuery(PreparedFunction *F, PreparedFunction *G, EquivalenceType type, SearchControl *control) {
+    TaskGraph *graph = initTaskGraph(control->threads);
+    OrthoderivativeJob jobs[2];
+    // The orthoderivative of a function that is attached to a store may already be computed
+    bool orthoderivatives = F->quadraticApn && G->quadraticApn && type != LINEAR_EQUIVALENCE;
+    bool computeF = orthoderivatives && !F->orthoderivativeComputed;
+    bool computeG = orthoderivatives && !G->orthoderivativeComputed;
+    if (computeF) addOrthoderivativeTasks(graph, &jobs[0], F, control);
+    if (computeG) addOrthoderivativeTasks(graph, &jobs[1], G, control);
+    // The invariants of linear and affine equivalence compare the partitions of the functions themselves
+    if (type != EA_EQUIVALENCE) {
+        addTask(graph, partitionTask, F);
+        addTask(graph, partitionTask, G);
+    }
+    runTaskGraph(graph);
+    destroyTaskGraph(graph);
+    if (computeF) free(jobs[0].ranges);
+    if (computeG) free(jobs[1].ranges);
+}
+
+/**
+ * The number of nodes each search for an automorphism may expand
+ */
+static size_t automorphismBudget(size_t n) {
+    return 1L << (n + 4);
+}
+
+AutomorphismOrbit *preparedOrbit(PreparedFunction *F) {
+    if (F->orbit == NULL) {
+        F->orbit = computeAutomorphismOrbit(F->function, preparedPartition(F), automorphismBudget(F->function->n));
+    }
+    return F->orbit;
+}
+
+AutomorphismOrbit *preparedOrthoderivativeOrbit(PreparedFunction *F) {
+    if (F->orthoderivativeOrbit == NULL) {
+        F->orthoderivativeOrbit = computeAutomorphismOrbit(preparedOrthoderivative(F),
+                                                           preparedOrthoderivativePartition(F),
+                                                           automorphismBudget(F->function->n));
+    }
+    return F->orthoderivativeOrbit;
+}
+
+/**
+ * Report the orbit used to break symmetries, and return its members. The searches of a portfolio share the report of
+ * the query.
+ */
+static const bool *symmetryOrbit(AutomorphismOrbit *orbit, SearchControl *control) {
+    if (control->race == NULL) {
+        printf("Symmetry: %zu automorphisms found, the orbit of b_1 has %zu elements\n", orbit->generators,
+               orbit->size);
+    }
+    return orbit->members;
+}
+
+/**
+ * Create the basis {b_1, ..., b_n} that the search guesses the images of, in the order given by its strategy. The
+ * basis is built greedily from a list of candidates, skipping the candidates in the span of the elements taken so far.
+ */
+static size_t *createSearchBasis(Partition *partitionF, SearchControl *control) {
+    size_t n = partitionF->n;
+    if (control->strategy == BASIS_STANDARD) return createStandardBasis(n);
+
+    size_t *candidates = malloc(sizeof(size_t) * 1L << n);
+    size_t count = 0;
+    if (control->strategy == BASIS_SMALLEST_BUCKET) {
+        // The elements of the smallest buckets have the fewest possible images, so the search branches less at the top
+        size_t *order = malloc(sizeof(size_t) * partitionF->numBuckets);
+        for (size_t i = 0; i < partitionF->numBuckets; ++i) {
+            size_t j = i;
+            while (j > 0 && partitionF->bucketSizes[order[j - 1]] > partitionF->bucketSizes[i]) {
+                order[j] = order[j - 1];
+                j -= 1;
+            }
+            order[j] = i;
+        }
+        for (size_t i = 0; i < partitionF->numBuckets; ++i) {
+            for (size_t j = partitionF->offsets[order[i]]; j < partitionF->offsets[order[i] + 1]; ++j) {
+                candidates[count++] = partitionF->elements[j];
+            }
+        }
+        free(order);
+    } else {
+        unsigned int seed = control->seed;
+        for (size_t x = 0; x < 1L << n; ++x) {
+            size_t j = (size_t) rand_r(&seed) % (x + 1);
+            candidates[x] = candidates[j];
+            candidates[j] = x;
+        }
+        count = 1L << n;
+    }
+
+    size_t *basis = malloc(sizeof(size_t) * n);
+    bool *spanned = calloc(sizeof(bool), 1L << n);
+    size_t *span = malloc(sizeof(size_t) * 1L << n); // The elements spanned so far, 2^k of them for k basis elements
+    span[0] = 0;
+    spanned[0] = true;
+    size_t dimension = 0;
+    for (size_t i = 0; i < count && dimension < n; ++i) {
+        size_t x = candidates[i];
+        if (spanned[x]) continue;
+        for (size_t j = 0; j < 1L << dimension; ++j) {
+            span[(1L << dimension) + j] = span[j] ^ x;
+            spanned[span[j] ^ x] = true;
+        }
+        basis[dimension++] = x;
+    }
+    free(span);
+    free(spanned);
+    free(candidates);
+    return basis;
+}
+
+/**
+ * The direction asked of the current stage: the walk recorded in the checkpoint if the stage resumes from one, since
+ * the positions of its frontier only make sense in that walk, and the direction of the search control otherwise
+ */
+static SearchDirection stageDirection(SearchControl *control) {
+    return resumesStage(control, control->stage) ? control->resumeDirection : control->direction;
+}
+
+/**
+ * Check if a linear search of dimension n may guess the inner permutation first, which needs the input partitions
+ */
+static bool considersInnerFirst(size_t n, SearchControl *control) {
+    SearchDirection direction = stageDirection(control);
+    return direction == DIRECTION_INNER || (direction == DIRECTION_AUTO && n <= AUTO_DIRECTION_DIMENSION);
+}
+
+/**
+ * The number of branches of the walk, as the product of the sizes of the buckets of the basis elements. It ignores
+ * all pruning, so it only breaks ties when no estimate of the walks could be made. The product is at most 2^(n^2),
+ * within a double.
+ */
+static double basisBranching(Partition *partition, const size_t *basis) {
+    double branching = 1;
+    for (size_t i = 0; i < partition->n; ++i) {
+        branching *= (double) partition->bucketSizes[partition->bucketOf[basis[i]]];
+    }
+    return branching;
+}
+
+/**
+ * One search of a portfolio, run on its own thread or in turns with the others
+ */
+typedef struct PortfolioSearch {
+    SearchEngine engine; // The engine to run
+    PreparedFunction *F; // The prepared function F
+    PreparedFunction *G; // The prepared function G
+    SearchControl *control; // The control of this search, with its own strategy
+    bool found; // True if the search found an equivalence
+} PortfolioSearch;
+
+static bool runEngine(SearchEngine engine, PreparedFunction *F, PreparedFunction *G, SearchControl *control) {
+    switch (engine) {
+        case ENGINE_LINEAR:
+            return searchLinear(F, G, control);
+        case ENGINE_ORTHODERIVATIVE:
+            return searchOrthoderivatives(F, G, false, control);
+        case ENGINE_AFFINE_ORTHODERIVATIVE:
+            return searchOrthoderivatives(F, G, true, control);
+        case ENGINE_AFFINE:
+            return searchAffine(F, G, control);
+    }
+    return false;
+}
+
+static void *runPortfolioSearch(void *argument) {
+    PortfolioSearch *search = argument;
+    search->found = runEngine(search->engine, search->F, search->G, search->control);
+    // Exploring the whole search space decides the query just as well as finding an equivalence
+    if (!search->found && search->control->status == SEARCH_RUNNING) {
+        winRace(search->control);
+    }
+    return NULL;
+}
+
+/**
+ * Run the searches of a portfolio on the calling thread, each taking turns of PORTFOLIO_SLICE steps, until they are
+ * all over. Once a search decides the stage, the others stop at their next turn.
+ */
+static void interleavePortfolioSearches(PortfolioSearch *searches, size_t count) {
+    SteppedSearch **stepped = malloc(sizeof(SteppedSearch *) * count);
+    for (size_t i = 0; i < count; ++i) {
+        stepped[i] = startSteppedSearch(searches[i].engine, searches[i].F, searches[i].G, searches[i].control);
+    }
+    size_t running = count;
+    while (running > 0) {
+        running = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (stepped[i]->status != SEARCH_RUNNING) continue;
+            SearchStatus status = stepSearch(stepped[i], PORTFOLIO_SLICE);
+            if (status == SEARCH_RUNNING) {
+                running += 1;
+                continue;
+            }
+            searches[i].found = status == SEARCH_FOUND;
+            if (!searches[i].found && searches[i].control->status == SEARCH_RUNNING) winRace(searches[i].control);
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        destroySteppedSearch(stepped[i]);
+    }
+    free(stepped);
+}
+
+/**
+ * Race the strategies of the portfolio on the stage that was just begun: the standard basis, the basis from the
+ * smallest buckets, and random bases with different seeds. The first search to finish decides the stage.
+ */
+static bool raceStrategies(SearchEngine engine, PreparedFunction *F, PreparedFunction *G, SearchControl *control) {
+    // The searches only read the prepared functions, so everything they need is computed before they start
+    size_t n = F->function->n;
+    if (engine == ENGINE_LINEAR || engine == ENGINE_AFFINE) {
+        preparedPartition(F);
+        preparedPartition(G);
+        if (engine == ENGINE_LINEAR && control->symmetryBreaking) symmetryOrbit(preparedOrbit(F), control);
+        if (engine == ENGINE_LINEAR && considersInnerFirst(n, control)) {
+            preparedInputPartition(F);
+            preparedInputPartition(G);
+        }
+    } else {
+        preparedOrthoderivative(G);
+        preparedOrthoderivativePartition(F);
+        preparedOrthoderivativePartition(G);
+        if (control->symmetryBreaking) symmetryOrbit(preparedOrthoderivativeOrbit(F), control);
+        if (engine == ENGINE_ORTHODERIVATIVE && considersInnerFirst(n, control)) {
+            preparedOrthoderivativeInputPartition(F);
+            preparedOrthoderivativeInputPartition(G);
+        }
+    }
+
+    SearchRace race;
+    pthread_mutex_init(&race.lock, NULL);
+    race.winner = NULL;
+    size_t count = control->portfolio;
+    PortfolioSearch *searches = malloc(sizeof(PortfolioSearch) * count);
+    pthread_t *threads = malloc(sizeof(pthread_t) * count);
+    for (size_t i = 0; i < count; ++i) {
+        BasisStrategy strategy = i == 0 ? BASIS_STANDARD : i == 1 ? BASIS_SMALLEST_BUCKET : BASIS_RANDOM;
+        searches[i].engine = engine;
+        searches[i].F = F;
+        searches[i].G = G;
+        searches[i].control = forkSearchControl(control, strategy, (unsigned int) i, &race);
+        // The threads are shared between the searches
+        searches[i].control->threads = control->threads > count ? control->threads / count : 1;
+        searches[i].found = false;
+    }
+    // A single thread is shared by taking turns, rather than by threads the system switches between
+    if (control->threads == 1) {
+        interleavePortfolioSearches(searches, count);
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            pthread_create(&threads[i], NULL, runPortfolioSearch, &searches[i]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    // Without a winner, all the searches were stopped by the time budget or by a signal
+    size_t winner = 0;
+    while (winner < count && searches[winner].control != race.winner) ++winner;
+    bool found = false;
+    if (winner < count) {
+        found = searches[winner].found;
+        recordEquivalence(control, searches[winner].control->L1, searches[winner].control->L2);
+        searches[winner].control->L1 = NULL;
+        searches[winner].control->L2 = NULL;
+        printf("Portfolio: search %zu of %zu (%s) finished first\n", winner + 1, count,
+               basisStrategyName(searches[winner].control->strategy));
+        control->status = searches[winner].control->status;
+    } else {
+        control->status = searches[0].control->status;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        destroySearchControl(searches[i].control);
+    }
+    free(searches);
+    free(threads);
+    pthread_mutex_destroy(&race.lock);
+    return found;
+}
+
+void destroyPreparedFunction(PreparedFunction *F) {
+    if (F->store != NULL) detachPreparedFunction(F);
+    if (F->function != NULL) destroyTruthTable(F->function);
+    if (F->orthoderivative != NULL) destroyTruthTable(F->orthoderivative);
+    if (F->partition != NULL) destroyPartition(F->partition);
+    if (F->orthoderivativePartition != NULL) destroyPartition(F->orthoderivativePartition);
+    if (F->inputPartition != NULL) destroyPartition(F->inputPartition);
+    if (F->orthoderivativeInputPartition != NULL) destroyPartition(F->orthoderivativeInputPartition);
+    if (F->orbit != NULL) destroyAutomorphismOrbit(F->orbit);
+    if (F->orthoderivativeOrbit != NULL) destroyAutomorphismOrbit(F->orthoderivativeOrbit);
+    free(F);
+}
+
+/**
+ * Check if the partitions of F and G have the same buckets, i.e. the same multiplicities with the same sizes
+ */
+static bool partitionsMatch(Partition *F, Partition *G) {
+    size_t *map = mapPreImages(F, G);
+    free(map);
+    return map != NULL;
+}
+
+/**
+ * Begin the stage of an engine, with its name and number of constants
+ */
+static bool beginEngineStage(SearchEngine engine, size_t n, SearchControl *control) {
+    switch (engine) {
+        case ENGINE_LINEAR:
+            return beginSearchStage(control, "linear", 1);
+        case ENGINE_ORTHODERIVATIVE:
+            return beginSearchStage(control, "orthoderivative", 1L << n);
+        case ENGINE_AFFINE_ORTHODERIVATIVE:
+            return beginSearchStage(control, "affine-orthoderivative", 1L << n);
+        case ENGINE_AFFINE:
+            // The constants c1 and c2 are searched together, as the single constant c2 * 2^n + c1
+            return beginSearchStage(control, "affine", 1L << 2 * n);
+    }
+    return false;
+}
+
+/**
+ * Fill functionF, functionG and partitionG for the constant c of an affine or orthoderivative search
+ */
+static void fillConstant(SteppedSearch *search, size_t c) {
+    size_t n = search->n;
+    if (search->engine == ENGINE_AFFINE) {
+        size_t c1 = c & ((1L << n) - 1);
+        size_t c2 = c >> n;
+        for (size_t x = 0; x < 1L << n; ++x) {
+            search->functionF->elements[x] = search->F->function->elements[x ^ c2];
+            search->functionG->elements[x] = search->G->function->elements[x] ^ c1;
+        }
+    } else {
+        memcpy(search->functionG->elements, preparedOrthoderivative(search->G)->elements, sizeof(size_t) * 1L << n);
+        addConstant(search->functionG, c); // Add the constant c1 to ODGc: ODGc' = ODGc + c_1
+    }
+    fillPartition(search->partitionG, search->functionG);
+}
+
+/**
+ * Decide whether the inner permutation is guessed first. Unless the direction is forced, by --direction or by the
+ * checkpoint the stage resumes from, both walks are estimated with Knuth's method on a few constants spread over those
+ * of the search, and the walk estimated to take the less time is chosen; the inner walk is empty if the partitions of
+ * the inputs do not match. If so, the basis is replaced by a basis of the inputs of G, in the order of the strategy.
+ */
+static bool innerFirst(SteppedSearch *search, Partition *inputsG, Partition *inputsF) {
+    SearchControl *control = search->control;
+    SearchDirection direction = stageDirection(control);
+    size_t *innerBasis = createSearchBasis(inputsG, control);
+    size_t *inputMap = direction == DIRECTION_INNER ? NULL : mapPreImages(inputsG, inputsF);
+    bool chosen = true;
+    if (resumesStage(control, control->stage)) {
+        if (control->race == NULL) printf("Direction: inner permutation first, as recorded in the checkpoint\n");
+    } else if (direction == DIRECTION_INNER) {
+        if (control->race == NULL) printf("Direction: inner permutation first, as forced by --direction\n");
+    } else if (inputMap == NULL) {
+        if (control->race == NULL) printf("Direction: inner permutation first, the inputs of F and G do not match\n");
+    } else {
+        // The orbit is not known yet, so the outer walk is estimated without breaking symmetries
+        TreeEstimate outer = {0}, inner = {0};
+        size_t samples = search->engine == ENGINE_LINEAR ? 1 : DIRECTION_CONSTANTS;
+        // A probe of the inner walk looks at up to 4^n pairs, so the budget and signals are polled between constants
+        for (size_t k = 0; k < samples && !searchShouldStopNow(control); ++k) {
+            size_t c = search->constant + k * (search->constants - search->constant) / samples;
+            if (search->engine != ENGINE_LINEAR) {
+                if (c >= search->constants || !shardOwnsConstant(control, c)) continue;
+                fillConstant(search, c);
+            }
+            size_t *map = mapPreImages(search->partitionF, search->partitionG);
+            if (map == NULL) continue; // Neither walk looks at a constant whose values do not match
+            estimateSearchTree(search->partitionF, search->partitionG, search->n, search->basis, map,
+                               search->functionF, search->functionG, false, false, NULL, control->lookahead,
+                               DIRECTION_PROBES, &outer);
+            estimateSearchTree(inputsG, inputsF, search->n, innerBasis, inputMap, search->functionF,
+                               search->functionG, false, true, NULL, control->lookahead, DIRECTION_PROBES, &inner);
+            free(map);
+        }
+        if (outer.seconds > 0 || inner.seconds > 0) {
+            chosen = inner.seconds < outer.seconds;
+            if (chosen && control->race == NULL) {
+                printf("Direction: inner permutation first, estimated at %.3g s instead of %.3g s\n", inner.seconds,
+                       outer.seconds);
+            }
+        } else {
+            double outerBranching = basisBranching(search->partitionF, search->basis);
+            double innerBranching = basisBranching(inputsG, innerBasis);
+            chosen = innerBranching < outerBranching;
+            if (chosen && control->race == NULL) {
+                printf("Direction: inner permutation first, about %.3g branches instead of %.3g\n", innerBranching,
+                       outerBranching);
+            }
+        }
+    }
+    if (chosen) {
+        free(search->basis);
+        search->basis = innerBasis;
+        search->inputsG = inputsG;
+        search->inputsF = inputsF;
+        search->inputMap = inputMap != NULL ? inputMap : mapPreImages(inputsG, inputsF);
+    } else {
+        free(innerBasis);
+        free(inputMap);
+    }
+    return chosen;
+}
+
+SteppedSearch *startSteppedSearch(SearchEngine engine, PreparedFunction *F, PreparedFunction *G,
+                                  SearchControl *control) {
+    size_t n = F->function->n;
+    SteppedSearch *search = calloc(1, sizeof(SteppedSearch));
+    search->engine = engine;
+    search->F = F;
+    search->G = G;
+    search->control = control;
+    search->n = n;
+    search->status = SEARCH_RUNNING;
+    // The walks of the affine engine find L1 and L2, and the search writes A1 and A2 once it knows the constants
+    search->reports = !control->muted;
+    if (engine == ENGINE_AFFINE) control->muted = true;
+    if (!beginEngineStage(engine, n, control)) {
+        // A stage that is skipped when resuming already completed without success
+        search->status = control->status == SEARCH_RUNNING ? SEARCH_EXHAUSTED : control->status;
+        return search;
+    }
+    search->constants = control->constants;
+    search->constant = engine == ENGINE_LINEAR ? 0 : control->c1;
+
+    if (engine == ENGINE_LINEAR) {
+        search->functionF = F->function;
+        search->functionG = G->function;
+        search->partitionF = preparedPartition(F);
+        search->partitionG = preparedPartition(G);
+    } else if (engine == ENGINE_AFFINE) {
+        /* F(x + c2) has the same values as F, so the partition of F is shared by all constants */
+        search->functionF = initTruthTable(n); // F(x + c2)
+        search->functionG = initTruthTable(n); // G + c1
+        search->partitionF = preparedPartition(F);
+        search->partitionG = initPartition(n); // The partition of G + c1, refilled for each constant
+    } else {
+        search->functionF = preparedOrthoderivative(F);
+        search->functionG = initTruthTable(n); // ODGc' = orthoderivativeG + c_1
+        search->partitionF = preparedOrthoderivativePartition(F);
+        search->partitionG = initPartition(n); // The partition of ODGc, refilled for each constant
+    }
+    search->basis = createSearchBasis(search->partitionF, control);
+
+    // Only a linear L2 can be guessed first, and the partitions of the inputs are the same for all the constants
+    if ((engine == ENGINE_LINEAR || engine == ENGINE_ORTHODERIVATIVE) && considersInnerFirst(n, control)) {
+        bool linear = engine == ENGINE_LINEAR;
+        Partition *inputsG = linear ? preparedInputPartition(G) : preparedOrthoderivativeInputPartition(G);
+        Partition *inputsF = linear ? preparedInputPartition(F) : preparedOrthoderivativeInputPartition(F);
+        search->inner = innerFirst(search, inputsG, inputsF);
+    }
+    control->walkDirection = search->inner ? DIRECTION_INNER : DIRECTION_OUTER;
+    // The orbit is the orbit of the first standard basis element, so it only applies if the basis starts with it
+    if (engine != ENGINE_AFFINE && !search->inner && control->symmetryBreaking && search->basis[0] == 1 &&
+        (engine != ENGINE_LINEAR || partitionsMatch(search->partitionF, search->partitionG))) {
+        search->orbit = symmetryOrbit(engine == ENGINE_LINEAR ? preparedOrbit(F) : preparedOrthoderivativeOrbit(F),
+                                      control);
+    }
+    return search;
+}
+
+/**
+ * End the stepped search, reporting the estimate if the search was only estimated
+ */
+static void endSteppedSearch(SteppedSearch *search, SearchStatus status) {
+    SearchControl *control = search->control;
+    if (control->estimateProbes > 0) reportEstimate(control);
+    search->status = status == SEARCH_EXHAUSTED && control->status != SEARCH_RUNNING ? control->status : status;
+}
+
+/**
+ * Free the walk of the current constant, and go on to the next constant unless the walk ended the search
+ */
+static void endConstant(SteppedSearch *search, SearchStatus status) {
+    if (search->walk != NULL) {
+        destroyTreeWalk(search->walk);
+        destroyLeafCheck(search->leaves);
+        search->walk = NULL;
+        search->leaves = NULL;
+    }
+    free(search->map);
+    search->map = NULL;
+    if (status == SEARCH_FOUND) {
+        // G + c1 = L1 * F(x + c2) * L2, i.e. G = A1 * F * A2 with A1 = L1 + c1 and A2 = L2 + c2
+        if (search->engine == ENGINE_AFFINE) {
+            SearchControl *control = search->control;
+            addConstant(control->L1, search->constant & ((1L << search->n) - 1));
+            addConstant(control->L2, search->constant >> search->n);
+            if (search->reports) {
+                emitMap("A1", control->L1);
+                emitMap("A2", control->L2);
+            }
+        }
+        endSteppedSearch(search, SEARCH_FOUND);
+    } else if (status == SEARCH_EXHAUSTED && search->control->status == SEARCH_RUNNING) {
+        search->constant += 1;
+    } else {
+        endSteppedSearch(search, status);
+    }
+}
+
+/**
+ * Set up the walk of the next constant that this search looks at, or end the search if there is none. When the search
+ * is only estimated, the tree of the constant is estimated right away instead.
+ */
+static void beginConstant(SteppedSearch *search) {
+    SearchControl *control = search->control;
+    size_t n = search->n;
+    size_t c = search->constant;
+    // The constants of other shards are skipped, and only a few constants are looked at when estimating
+    while (search->engine != ENGINE_LINEAR && c < search->constants &&
+           (!shardOwnsConstant(control, c) || !sampledConstant(control, c))) {
+        ++c;
+    }
+    search->constant = c;
+    if (c >= search->constants) {
+        endSteppedSearch(search, SEARCH_EXHAUSTED);
+        return;
+    }
+
+    TruthTable *functionF = search->functionF;
+    TruthTable *functionG = search->functionG;
+    if (search->engine != ENGINE_LINEAR) {
+        control->c1 = c;
+        fillConstant(search, c);
+    }
+    search->map = mapPreImages(search->partitionF, search->partitionG); // Create a mapping between the pre-images
+    // When L2 is guessed first, the values must still match, and the walk follows the map of the inputs
+    size_t *walkMap = search->inner && search->map != NULL ? search->inputMap : search->map;
+    Partition *from = search->inner ? search->inputsG : search->partitionF;
+    Partition *to = search->inner ? search->inputsF : search->partitionG;
+    bool affineSearch = search->engine == ENGINE_AFFINE_ORTHODERIVATIVE;
+
+    if (control->estimateProbes > 0) {
+        if (walkMap != NULL) {
+            estimateSearchTree(from, to, n, search->basis, walkMap, functionF, functionG, affineSearch, search->inner,
+                               search->orbit, control->lookahead, control->estimateProbes, &control->estimate);
+        }
+        control->estimate.constants += 1;
+        endConstant(search, SEARCH_EXHAUSTED);
+    } else if (walkMap == NULL) {
+        endConstant(search, SEARCH_EXHAUSTED);
+    } else {
+        // Calculate outer permutation, L1, or the inner permutation L2 first
+        search->leaves = search->inner ? initReverseLeafCheck(functionF, functionG) :
+                         initLeafCheck(functionF, functionG, search->basis, affineSearch, control->lookahead > 0);
+        search->walk = initTreeWalk(from, to, n, search->basis, walkMap, search->leaves, search->orbit, control);
+    }
+}
+
+SearchStatus stepSearch(SteppedSearch *search, size_t budget) {
+    size_t spent = 0;
+    while (search->status == SEARCH_RUNNING && spent < budget) {
+        if (search->walk != NULL) {
+            size_t nodes = search->walk->nodes;
+            SearchStatus status = guessValuesOfL(search->walk, budget - spent);
+            spent += search->walk->nodes - nodes;
+            if (status != SEARCH_RUNNING) endConstant(search, status);
+            continue;
+        }
+        spent += 1;
+        beginConstant(search);
+    }
+    return search->status;
+}
+
+void destroySteppedSearch(SteppedSearch *search) {
+    search->control->muted = !search->reports;
+    if (search->walk != NULL) {
+        destroyTreeWalk(search->walk);
+        destroyLeafCheck(search->leaves);
+    }
+    if (search->engine != ENGINE_LINEAR && search->partitionG != NULL) {
+        destroyTruthTable(search->functionG);
+        destroyPartition(search->partitionG);
+    }
+    if (search->engine == ENGINE_AFFINE && search->functionF != NULL) destroyTruthTable(search->functionF);
+    free(search->map);
+    free(search->inputMap);
+    free(search->basis);
+    free(search);
+}
+
+/**
+ * Run an engine to the end: a portfolio races its strategies, a single strategy is stepped without a budget
+ */
+static bool runSearch(SearchEngine engine, PreparedFunction *F, PreparedFunction *G, SearchControl *control) {
+    if (control->portfolio > 1) {
+        return beginEngineStage(engine, F->function->n, control) && raceStrategies(engine, F, G, control);
+    }
+    SteppedSearch *search = startSteppedSearch(engine, F, G, control);
+    bool foundSolution = stepSearch(search, SIZE_MAX) == SEARCH_FOUND;
+    destroySteppedSearch(search);
+    return foundSolution;
+}
+
+bool searchLinear(PreparedFunction *F, PreparedFunction *G, SearchControl *control) {
+    return runSearch(ENGINE_LINEAR, F, G, control);
+}
+
+bool searchOrthoderivatives(PreparedFunction *F, PreparedFunction *G, bool affineSearch, SearchControl *control) {
+    return runSearch(affineSearch ? ENGINE_AFFINE_ORTHODERIVATIVE : ENGINE_ORTHODERIVATIVE, F, G, control);
+}
+
+bool searchAffine(PreparedFunction *F, PreparedFunction *G, SearchControl *control) {
+    return runSearch(ENGINE_AFFINE, F, G, control);
+}
+
+void printEaCertificate(PreparedFunction *F, PreparedFunction *G, SearchControl *control) {
+    if (control->L1 == NULL) return;
+    TruthTable *A1, *A;
+    if (eaCertificate(F->function, G->function, control->L1, control->L2, &A1, &A)) {
+        printf("Certificate: G = A1 * F * A2 + A\n");
+        emitMap("A1", A1);
+        emitMap("A2", control->L2);
+        emitMap("A", A);
+    } else {
+        printf("Certificate: the equivalence of the orthoderivatives does not give an EA-equivalence of F and G\n");
+    }
+    destroyTruthTable(A1);
+    destroyTruthTable(A);
+}
+
+bool invariantsMatch(PreparedFunction *F, PreparedFunction *G, EquivalenceType type) {
+    if (F->function->n != G->function->n) {
+        printf("Invariant: the dimensions differ\n");
+        return false;
+    }
+    // EA-equivalence preserves the degree only if it is at least 2, since affine terms can be added
+    if (F->degree != G->degree && (type != EA_EQUIVALENCE || F->degree > 1 || G->degree > 1)) {
+        printf("Invariant: the algebraic degrees differ (%zu and %zu)\n", F->degree, G->degree);
+        return false;
+    }
+    // The components of each degree are permuted by the equivalences, except for the affine terms EA can add
+    size_t n = F->function->n;
+    for (size_t d = type == EA_EQUIVALENCE ? 2 : 1; d <= n; ++d) {
+        if (F->degrees.ranks[d] != G->degrees.ranks[d]) {
+            printf("Invariant: the degree profiles differ (%zu and %zu components of degree %zu or more)\n",
+                   componentsOfDegree(&F->degrees, n, d), componentsOfDegree(&G->degrees, n, d), d);
+            return false;
+        }
+    }
+    if (type == EA_EQUIVALENCE) {
+        if (F->quadraticApn && G->quadraticApn &&
+            !partitionsMatch(preparedOrthoderivativePartition(F), preparedOrthoderivativePartition(G))) {
+            printf("Invariant: the partitions of the orthoderivatives differ\n");
+            return false;
+        }
+        return true;
+    }
+    if (F->permutation != G->permutation) {
+        printf("Invariant: only one of the functions is a permutation\n");
+        return false;
+    }
+    if (type == LINEAR_EQUIVALENCE && (F->function->elements[0] == 0) != (G->function->elements[0] == 0)) {
+        printf("Invariant: only one of the functions maps 0 to 0\n");
+        return false;
+    }
+    if (!partitionsMatch(preparedPartition(F), preparedPartition(G))) {
+        printf("Invariant: the partitions of the functions differ\n");
+        return false;
+    }
+    return true;
+}
+
+bool dispatchQuery(PreparedFunction *F, PreparedFunction *G, EquivalenceType type, SearchControl *control) {
+    // The preparation may have been cancelled, and whatever it left out must not be computed without polling
+    if (searchShouldStopNow(control)) return false;
+    if (!invariantsMatch(F, G, type)) return false;
+
+    switch (type) {
+        case LINEAR_EQUIVALENCE:
+            if (F->permutation && G->permutation) {
+                printf("Engine: linear permutation\n");
+                return searchLinearPermutations(F->function, G->function, control);
+            }
+            printf("Engine: linear\n");
+            return searchLinear(F, G, control);
+        case AFFINE_EQUIVALENCE:
+            // The partition of a permutation is a single bucket, so permutations have a dedicated engine
+            if (F->permutation && G->permutation) {
+                printf("Engine: permutation\n");
+                return searchPermutations(F->function, G->function, control);
+            }
+            /* Affine equivalent functions are EA-equivalent; the orthoderivatives decide EA-equivalence quickly, and
+             * their preprocessing is shared with the invariants. The filter needs the whole search space, so it is
+             * not used by shards, and it already succeeded if we resume the affine stage. */
+            if (F->quadraticApn && G->quadraticApn && control->shardCount == 1 && !resumesStage(control, "affine")) {
+                printf("Engine: orthoderivative (filter)\n");
+                // The filter only rules queries out, and the equivalence of the orthoderivatives is not written
+                bool muted = control->muted;
+                control->muted = true;
+                bool possible = searchOrthoderivatives(F, G, false, control);
+                control->muted = muted;
+                recordEquivalence(control, NULL, NULL);
+                if (!possible) return false;
+            }
+            printf("Engine: affine\n");
+            return searchAffine(F, G, control);
+        case EA_EQUIVALENCE:
+            if (F->degree <= 1 && G->degree <= 1) {
+                printf("Both functions are affine, and therefore EA-equivalent\n");
+                return true;
+            }
+            if (F->quadraticApn && G->quadraticApn) {
+                printf("Engine: orthoderivative\n");
+                if (!searchOrthoderivatives(F, G, false, control)) return false;
+                printEaCertificate(F, G, control);
+                return true;
+            }
+            /* No engine decides EA-equivalence here; affine equivalence is sufficient, but not necessary */
+            if (F->permutation && G->permutation) {
+                printf("Engine: permutation (sufficient for EA-equivalence)\n");
+                if (searchPermutations(F->function, G->function, control)) return true;
+            } else {
+                printf("Engine: affine (sufficient for EA-equivalence)\n");
+                if (searchAffine(F, G, control)) return true;
+            }
+            if (control->status == SEARCH_RUNNING) control->status = SEARCH_UNDECIDED;
+            return false;
+    }
+    return false;
+}
+
+bool parseQueryArguments(int argc, char *argv[], SearchControl *control, QueryArguments *arguments, bool chooseType,
+                         void (*printHelp)(), int *status) {
+    arguments->functionF = NULL;
+    arguments->functionG = NULL;
+    arguments->times = false;
+    *status = 0;
+    if (argc < 2) {
+        printHelp();
+        return false;
+    }
+
+    // Loop over the arguments given
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-') {
+            if (argv[i][1] == '-') {
+                // Long flags configure the search control
+                if (!parseControlFlag(control, argc, argv, &i)) {
+                    printf("Unknown flag, %s\n", argv[i]);
+                    *status = 1;
+                    return false;
+                }
+                continue;
+            }
+            char flag = argv[i][1];
+            if (flag == 'h') {
+                printHelp();
+                return false;
+            } else if (flag == 't') {
+                arguments->times = true;
+            } else if (chooseType && flag == 'e') {
+                arguments->type = EA_EQUIVALENCE;
+            } else if (chooseType && flag == 'a') {
+                arguments->type = AFFINE_EQUIVALENCE;
+            } else if (chooseType && flag == 'l') {
+                arguments->type = LINEAR_EQUIVALENCE;
+            } else {
+                printf("Unknown flag, %s\n", argv[i]);
+                *status = 1;
+                return false;
+            }
+        } else if (arguments->functionF == NULL) {
+            arguments->functionF = parseFile(argv[i]);
+            printf("%s\n", argv[i]);
+        } else if (arguments->functionG == NULL) {
+            arguments->functionG = parseFile(argv[i]);
+        }
+    }
+    if (arguments->functionF == NULL) {
+        printf("Missing function F. \n");
+        return false;
+    }
+    return true;
+}
+
+void startQuery(SearchControl *control, const char *tool, QueryArguments *arguments, PreparedFunction **preparedF,
+                PreparedFunction **preparedG) {
+    startSearchControl(control, tool, arguments->functionF, arguments->functionG);
+    // With a store, F is mapped from it if another process already prepared F, and published to it otherwise
+    *preparedF = attachPreparedFunction(control->storeFile, arguments->functionF);
+    if (*preparedF == NULL) *preparedF = prepareFunction(arguments->functionF);
+    *preparedG = prepareFunction(arguments->functionG);
+    prepareQuery(*preparedF, *preparedG, arguments->type, control);
+    // What a cancelled preparation left out must not be computed without polling, nor be published
+    if (searchShouldStopNow(control)) return;
+    if (control->storeFile != NULL && (*preparedF)->store == NULL) {
+        publishPreparedFunction(*preparedF, control->storeFile);
+    }
+}
@@ -0,0 +1,306 @@
+#ifndef AFFINE_DISPATCH_H
+#define AFFINE_DISPATCH_H
+
+#include "structures.h"
+#include "control.h"
+#include "automorphism.h"
+#include "equivalence.h"
+#include "bitslice.h"
+
+/**
+ * In dispatch, you will find the search engines shared by all programs, and the dispatcher that inspects a query and
+ * sends it to the fastest engine that applies.
+ */
+
+/**
+ * The kind of equivalence a query asks for
+ */
+typedef enum EquivalenceType {
+    LINEAR_EQUIVALENCE, // G = L1 * F * L2
+    AFFINE_EQUIVALENCE, // G = A1 * F * A2
+    EA_EQUIVALENCE // G = A1 * F * A2 + A
+} EquivalenceType;
+
+/**
+ * A function together with everything computed from it. The expensive parts are computed the first time they are
+ * needed and then shared by all the stages of a query.
+ */
+typedef struct PreparedFunction {
+    TruthTable *function; // The function itself
+    bool permutation; // True if the function is a permutation
+    size_t degree; // The algebraic degree of the function
+    DegreeProfile degrees; // The degrees of the components of the function
+    bool quadraticApn; // True if the function is quadratic and APN, i.e. if the orthoderivative approach applies
+    bool orthoderivativeComputed; // True once we tried to compute the orthoderivative
+    TruthTable *orthoderivative; // The orthoderivative, NULL if not computed yet or if it does not exist
+    Partition *partition; // Partition of the function, NULL if not computed yet
+    Partition *orthoderivativePartition; // Partition of the orthoderivative, NULL if not computed yet
+    Partition *inputPartition; // Partition of the inputs of the function, NULL if not computed yet
+    Partition *orthoderivativeInputPartition; // Partition of the inputs of the orthoderivative, NULL if not computed
+    AutomorphismOrbit *orbit; // Orbit of b_1 under the automorphisms of the function, NULL if not computed yet
+    AutomorphismOrbit *orthoderivativeOrbit; // Orbit of b_1 under the automorphisms of the orthoderivative
+    struct SharedStore *store; // The store the tables of the function are mapped from, NULL if it owns all of them
+} PreparedFunction;
+
+/**
+ * Prepare a function for the search. The cheap properties (bijectivity, degree profile) are computed right away.
+ * @param F The function F, the prepared function takes over the truth table
+ * @return A new prepared function
+ */
+PreparedFunction *prepareFunction(TruthTable *F);
+
+/**
+ * Compute the parts of two prepared functions that a query will need, in parallel: the orthoderivatives of F and G
+ * at the same time, each split into ranges of directions, and the partitions as soon as their inputs are ready.
+ * Whatever is not computed here is still computed when it is first needed. When the search is asked to stop, the
+ * orthoderivatives are cancelled and left not computed.
+ * @param F The prepared function F
+ * @param G The prepared function G
+ * @param type The kind of equivalence the query asks for
+ * @param control The search control, giving the number of threads and polled for stop requests
+ */
+void prepareQuery(PreparedFunction *F, PreparedFunction *G, EquivalenceType type, SearchControl *control);
+
+/**
+ * Get the orthoderivative of a prepared function, computing it if needed.
+ * @param F The prepared function
+ * @return The orthoderivative, or NULL if it does not exist
+ */
+TruthTable *preparedOrthoderivative(PreparedFunction *F);
+
+/**
+ * Get the partition of a prepared function, computing it if needed.
+ * @param F The prepared function
+ * @return The partition of the function
+ */
+Partition *preparedPartition(PreparedFunction *F);
+
+/**
+ * Get the partition of the orthoderivative of a prepared function, computing it if needed.
+ * @param F The prepared function, which must have an orthoderivative
+ * @return The partition of the orthoderivative
+ */
+Partition *preparedOrthoderivativePartition(PreparedFunction *F);
+
+/**
+ * Get the partition of the inputs of a prepared function, computing it if needed.
+ * @param F The prepared function
+ * @return The partition of the inputs of the function
+ */
+Partition *preparedInputPartition(PreparedFunction *F);
+
+/**
+ * Get the partition of the inputs of the orthoderivative of a prepared function, computing it if needed.
+ * @param F The prepared function, which must have an orthoderivative
+ * @return The partition of the inputs of the orthoderivative
+ */
+Partition *preparedOrthoderivativeInputPartition(PreparedFunction *F);
+
+/**
+ * Get the orbit of the first basis element under the automorphisms of a prepared function, computing it if needed.
+ * @param F The prepared function
+ * @return The orbit
+ */
+AutomorphismOrbit *preparedOrbit(PreparedFunction *F);
+
+/**
+ * Get the orbit of the first basis element under the automorphisms of the orthoderivative of a prepared function,
+ * computing it if needed.
+ * @param F The prepared function, which must have an orthoderivative
+ * @return The orbit
+ */
+AutomorphismOrbit *preparedOrthoderivativeOrbit(PreparedFunction *F);
+
+/**
+ * Free the memory allocated for the prepared function, including its truth table, and unmap its store if it has one
+ * @param F The prepared function to destroy
+ */
+void destroyPreparedFunction(PreparedFunction *F);
+
+/**
+ * The engines that guess L1 over the partitions, and that can be stepped or raced with different bases
+ */
+typedef enum SearchEngine {
+    ENGINE_LINEAR, // L1 * F * L2 = G, see searchLinear
+    ENGINE_ORTHODERIVATIVE, // The orthoderivatives with linear L1, L2, see searchOrthoderivatives
+    ENGINE_AFFINE_ORTHODERIVATIVE, // The orthoderivatives with an affine L2
+    ENGINE_AFFINE // A1 * F * A2 = G, see searchAffine
+} SearchEngine;
+
+/**
+ * A search of one engine that runs a slice at a time, so that a caller can interleave it with other work, stop it at
+ * any point and look at its state in between. The constants of the stage are taken one after the other, and the tree
+ * of each constant is walked by a TreeWalk; while a constant is being searched, its walk shows the path to the node
+ * being expanded, and the search control shows the frontier as it would be written to a checkpoint.
+ */
+typedef struct SteppedSearch {
+    SearchEngine engine; // The engine
+    PreparedFunction *F; // The prepared function F
+    PreparedFunction *G; // The prepared function G
+    SearchControl *control; // The search control
+    size_t n; // Dimension
+    size_t constants; // Number of constants of the stage
+    bool inner; // True if the inner permutation is guessed first
+    TruthTable *functionF; // The function F under the current constant
+    TruthTable *functionG; // The function G under the current constant
+    Partition *partitionF; // The partition of functionF
+    Partition *partitionG; // The partition of functionG
+    Partition *inputsF; // The partition of the inputs of functionF, if inner
+    Partition *inputsG; // The partition of the inputs of functionG, if inner
+    size_t *basis; // The basis {b_1, ..., b_n}, in the order of the strategy
+    size_t *inputMap; // Tells how inputsG -> inputsF, if inner
+    const bool *orbit; // The orbit of b_1 used to break symmetries, or NULL
+    size_t constant; // The constant being searched, or the next one to search if there is no walk
+    size_t *map; // Tells how partitionF -> partitionG under the current constant
+    LeafCheck *leaves; // The leaf check of the current constant, NULL between constants
+    TreeWalk *walk; // The walk of the current constant, NULL between constants
+    SearchStatus status; // SEARCH_RUNNING until the search is over, then how it ended
+    bool reports; // True if the search writes the equivalence it finds, false if the control was muted
+} SteppedSearch;
+
+/**
+ * Begin the stage of an engine and prepare a stepped search of it with the strategy of the search control. Nothing is
+ * walked yet. A portfolio is not raced here, the search only runs the strategy of the control.
+ * @param engine The engine
+ * @param F The prepared function F, which must have an orthoderivative for the orthoderivative engines
+ * @param G The prepared function G, which must have an orthoderivative for the orthoderivative engines
+ * @param control The search control, which must have been started
+ * @return A new stepped search, already over if the stage is skipped or the search control has stopped
+ */
+SteppedSearch *startSteppedSearch(SearchEngine engine, PreparedFunction *F, PreparedFunction *G,
+                                  SearchControl *control);
+
+/**
+ * Run the search for a number of steps. A step expands one node of a walk or of the search for an inner permutation
+ * at one of its leaves, or sets up the walk of the next constant. When an equivalence is found, it is printed and recorded in the search control.
+ * @param search The stepped search
+ * @param budget The number of steps to run at most, SIZE_MAX to run until the end
+ * @return SEARCH_RUNNING if the budget was spent first, SEARCH_FOUND, SEARCH_EXHAUSTED once every constant has been
+ * searched, or the status of the search control if it stopped the search
+ */
+SearchStatus stepSearch(SteppedSearch *search, size_t budget);
+
+/**
+ * Free the memory allocated for the stepped search
+ * @param search The stepped search to destroy
+ */
+void destroySteppedSearch(SteppedSearch *search);
+
+/**
+ * The largest dimension for which the direction of a linear search is chosen automatically: the partitions of the
+ * inputs take 4^n steps, so above it the outer permutation is guessed first unless asked otherwise
+ */
+#define AUTO_DIRECTION_DIMENSION 12
+
+/**
+ * The number of constants, and of random paths per constant, on which the automatic direction estimates both walks
+ */
+#define DIRECTION_CONSTANTS 4
+#define DIRECTION_PROBES 4
+
+/**
+ * The number of steps a search of a portfolio runs at a time when the searches take turns on a single thread
+ */
+#define PORTFOLIO_SLICE 4096
+
+/**
+ * Search for a linear equivalence L1 * F * L2 = G by guessing L1 on the partitions of F and G, or L2 on the
+ * partitions of their inputs, whichever the direction of the search control picks.
+ * @param F The prepared function F
+ * @param G The prepared function G
+ * @param control The search control
+ * @return True if an equivalence was found
+ */
+bool searchLinear(PreparedFunction *F, PreparedFunction *G, SearchControl *control);
+
+/**
+ * Search for an equivalence between the orthoderivatives of F and G, for all constants c1 added to the
+ * orthoderivative of G. With linear L1, L2 this decides EA-equivalence of quadratic APN functions. The linear search
+ * takes the direction of the search control, which is chosen once for all constants, since the partitions of the
+ * inputs do not depend on c1.
+ * @param F The prepared function F, which must have an orthoderivative
+ * @param G The prepared function G, which must have an orthoderivative
+ * @param affineSearch True if L2 should be searched as an affine permutation
+ * @param control The search control
+ * @return True if an equivalence was found
+ */
+bool searchOrthoderivatives(PreparedFunction *F, PreparedFunction *G, bool affineSearch, SearchControl *control);
+
+/**
+ * General search for an affine equivalence A1 * F * A2 = G, that works for any functions. For all constants c1, c2
+ * we search for a linear equivalence between F(x + c2) and G + c1.
+ * @param F The prepared function F
+ * @param G The prepared function G
+ * @param control The search control
+ * @return True if an equivalence was found
+ */
+bool searchAffine(PreparedFunction *F, PreparedFunction *G, SearchControl *control);
+
+/**
+ * Print the complete EA-equivalence G = A1 * F * A2 + A derived from the equivalence of the orthoderivatives that the
+ * last search found, see eaCertificate.
+ * @param F The prepared function F
+ * @param G The prepared function G
+ * @param control The search control, holding the equivalence of the orthoderivatives
+ */
+void printEaCertificate(PreparedFunction *F, PreparedFunction *G, SearchControl *control);
+
+/**
+ * Compare the cheap invariants of F and G for the given kind of equivalence.
+ * @param F The prepared function F
+ * @param G The prepared function G
+ * @param type The kind of equivalence
+ * @return True if no invariant rules out the equivalence
+ */
+bool invariantsMatch(PreparedFunction *F, PreparedFunction *G, EquivalenceType type);
+
+/**
+ * Decide a query: compare the invariants, then run the fastest engine that applies, falling back to the general
+ * affine search. If no engine can decide the query, the status of the control is set to SEARCH_UNDECIDED.
+ * @param F The prepared function F
+ * @param G The prepared function G
+ * @param type The kind of equivalence
+ * @param control The search control, which must have been started
+ * @return True if an equivalence was found
+ */
+bool dispatchQuery(PreparedFunction *F, PreparedFunction *G, EquivalenceType type, SearchControl *control);
+
+/**
+ * What the command line of a program asks for
+ */
+typedef struct QueryArguments {
+    TruthTable *functionF; // The function F, NULL if no file was given
+    TruthTable *functionG; // The function G, NULL if no second file was given and G has to be created
+    EquivalenceType type; // The kind of equivalence, chosen with -e, -a or -l where the program allows it
+    bool times; // True if the run time should be printed, -t
+} QueryArguments;
+
+/**
+ * Read the command line that all the programs share: -h prints the help, -t the run time, the long flags configure
+ * the search control, and the first two other arguments are the files of F and G.
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * @param control The search control, which receives the long flags
+ * @param arguments Receives what the command line asks for; its type is kept unless chooseType is true
+ * @param chooseType True if the flags -e, -a and -l choose the kind of equivalence
+ * @param printHelp Prints the help of the program
+ * @param status Receives the exit status of the program if it is done
+ * @return True if the query should be run, false if the program is done
+ */
+bool parseQueryArguments(int argc, char *argv[], SearchControl *control, QueryArguments *arguments, bool chooseType,
+                         void (*printHelp)(), int *status);
+
+/**
+ * Start the search control and prepare F and G for a query. With a store, F is mapped from it if another process
+ * already prepared F, and published to it otherwise. If the search is asked to stop during the preparation, the status
+ * of the control is set accordingly and nothing is published.
+ * @param control The search control
+ * @param tool The name of the program, recorded in the checkpoints
+ * @param arguments The functions F and G, which the prepared functions take over
+ * @param preparedF Receives the prepared function F
+ * @param preparedG Receives the prepared function G
+ */
+void startQuery(SearchControl *control, const char *tool, QueryArguments *arguments, PreparedFunction **preparedF,
+                PreparedFunction **preparedG);
+
+#endif //AFFINE_DISPATCH_H
@@ -1,29 +1,60 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
 #include "structures.h"
 #include <memory.h>
 #include "equivalence.h"
+#include "control.h"
+#include "output.h"
+#include "permutation.h"
 
 TruthTable *parseFile(char *file) {
+    char error[READ_ERROR_SIZE];
+    TruthTable *f = readFile(file, error);
+    if (f == NULL) {
+        printf("%s\n", error);
+        exit(1);
+    }
+    return f;
+}
+
+TruthTable *readFile(char *file, char *error) {
     size_t n; // Dimension of the truth table
     FILE *fp = fopen(file, "r");
 
     // Check if file is found
     if (fp == NULL) {
-        printf("File, %s, not found\n", file);
-        fclose(fp);
-        exit(1);
+        snprintf(error, READ_ERROR_SIZE, "File, %s, not found", file);
+        return NULL;
     }
 
     // If the file is found, we start parsing the file:
     // First line should contain one integer, the dimension of the function F.
-    fscanf(fp, "%zu", &n); // Set the dimension, n, for the truth table
+    if (fscanf(fp, "%zu", &n) != 1 || n == 0 || n > MAX_DIMENSION) {
+        snprintf(error, READ_ERROR_SIZE, "File, %s, does not start with a dimension between 1 and %d", file,
+                 MAX_DIMENSION);
+        fclose(fp);
+        return NULL;
+    }
     TruthTable *f = initTruthTable(n);
+    if (f->elements == NULL) {
+        snprintf(error, READ_ERROR_SIZE, "Not enough memory for a function of dimension %zu", n);
+        destroyTruthTable(f);
+        fclose(fp);
+        return NULL;
+    }
 
-    // Set all the elements in the truth table. Should be 2^n elements.
+    // Set all the elements in the truth table. Should be 2^n elements, each below 2^n.
     for (size_t i = 0; i < 1L << n; ++i) {
-        fscanf(fp, "%zu", &f->elements[i]);
+        if (fscanf(fp, "%zu", &f->elements[i]) != 1 || f->elements[i] >> n != 0) {
+            snprintf(error, READ_ERROR_SIZE, "File, %s, does not hold 2^%zu elements below 2^%zu", file, n, n);
+            destroyTruthTable(f);
+            fclose(fp);
+            return NULL;
+        }
     }
 
     fclose(fp);
@@ -36,15 +67,14 @@ size_t *mapPreImages(Partition *F, Partition *G) {
 
     size_t *map = malloc(sizeof(size_t) * F->numBuckets); // The new map where F -> G
 
-    // Loop over all the buckets and map F -> G with their pre-images.
-    for (int i = 0; i < F->numBuckets; ++i) {
-        for (int j = 0; j < G->numBuckets; ++j) {
-            if (F->multiplicities[i] == G->multiplicities[j]) {
-                // If the multiplicity in F[i] == G[j], we have found the multiplicities that maps to another
-                map[i] = j;
-                break;
-            }
+    /* A bucket can only map to a bucket with the same multiplicity and the same size. The buckets of both partitions
+     * are sorted by multiplicity, so the buckets map in order, or not at all. */
+    for (size_t i = 0; i < F->numBuckets; ++i) {
+        if (F->multiplicities[i] != G->multiplicities[i] || F->bucketSizes[i] != G->bucketSizes[i]) {
+            free(map);
+            return NULL;
         }
+        map[i] = i;
     }
     return map;
 }
@@ -57,303 +87,1190 @@ void countElements(TruthTable *F, size_t *occurrences) {
     }
 }
 
-bool outerPermutation(Partition *F, Partition *G, size_t n, size_t *basis, size_t *map, TruthTable *functionF,
-                      TruthTable *functionG, bool affineSearch) {
-    size_t *images = malloc(sizeof(size_t) * n); // The images of the basis elements under l
-    size_t *generated = calloc(sizeof(size_t), 1L << n); // A partial truth table for l
-    bool *generatedImages = calloc(sizeof(bool), 1L << n);
-    bool foundSolution = false;
+/**
+ * Compute the elements of the span of a basis, indexed by the linear combinations: element number c is the sum of the
+ * basis elements b_i with bit i set in c. For the standard basis, element number c is c itself.
+ */
+static size_t *spanBasis(size_t n, const size_t *basis) {
+    size_t *span = malloc(sizeof(size_t) * 1L << n);
+    span[0] = 0;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t c = 0; c < 1L << i; ++c) {
+            span[c | 1L << i] = span[c] ^ basis[i];
+        }
+    }
+    return span;
+}
 
-    /**
-     * Create dictionaries indexing buckets by elements
-     * For instance, fClassPosition[i] would be the index of the bucket w.r.t. F containing the element i.
-     */
-    size_t *fClass = createBucketRepresentation(F, n);
-    size_t *gClass = createBucketRepresentation(G, n);
+/**
+ * Number of words of a bitset of 2^n bits
+ */
+static inline size_t bitsetWords(size_t n) {
+    return n < 6 ? 1 : 1L << (n - 6);
+}
 
-    // Recursively guess the values of l on the basis (essentially, a dfs with backtracking upon contradiction
-    guessValuesOfL(0, basis, images, F, G, n, generated, generatedImages, fClass, gClass, map, &foundSolution,
-                   functionF,
-                   functionG, affineSearch);
+/**
+ * Check if every element of the bitset a is also in the bitset b
+ */
+static inline bool subsetOf(const uint64_t *a, const uint64_t *b, size_t words) {
+    for (size_t w = 0; w < words; ++w) {
+        if (a[w] & ~b[w]) return false;
+    }
+    return true;
+}
 
-    free(images);
-    free(generated);
-    free(generatedImages);
-    free(fClass);
-    free(gClass);
+bool outerPermutation(Partition *F, Partition *G, size_t n, size_t *basis, size_t *map, TruthTable *functionF,
+                      TruthTable *functionG, bool affineSearch, const bool *orbit, SearchControl *control) {
+    LeafCheck *leaves = initLeafCheck(functionF, functionG, basis, affineSearch, control->lookahead > 0);
+    TreeWalk *walk = initTreeWalk(F, G, n, basis, map, leaves, orbit, control);
+    bool foundSolution = guessValuesOfL(walk, SIZE_MAX) == SEARCH_FOUND;
+    destroyTreeWalk(walk);
+    destroyLeafCheck(leaves);
     return foundSolution;
 }
 
-void
-guessValuesOfL(size_t k, size_t *basis, size_t *images, Partition *partitionF, Partition *partitionG, size_t n,
-               size_t *generated, bool *generatedImages, size_t *fBucket, size_t *gBucket, size_t *map,
-               bool *foundSolution, TruthTable *functionF, TruthTable *functionG, bool affineSearch) {
-    if (*foundSolution) return;
-    /**
-     * If all basis elements have been assigned an image, and no contradictions have occurs, then we have found a
-     * linear permutation preserving the partition. We reconstruct its truth table, and add it to the linked list
-     * containing all permutations found by the search.
-     */
-    if (k == n) {
-        TruthTable *currentL1 = initTruthTable(n);
-        memcpy(currentL1->elements, generated, sizeof(size_t) * 1L << n);
-        TruthTable *L1Inverse = inverse(currentL1); // L1^{-1}
-        TruthTable *GPrime = compose(L1Inverse, functionG); // L1^{-1} * G = G'
-        TruthTable *L2 = initTruthTable(n);
-        L2->elements[0] = 0; // We know that the function is linear => L[0] -> 0
-
-        if (innerPermutation(functionF, GPrime, basis, L2, affineSearch)) {
-            /* At this point, we know (L1,L2) linear s.t. L1 * orthoderivativeF * L2 = orthoderivativeG */
-            *foundSolution = true;
-            printf(affineSearch ? "A1:\n" : "L1:\n");
-            printTruthTable(currentL1);
-            printf(affineSearch ? "A2:\n" : "L2:\n");
-            printTruthTable(L2);
-            destroyTruthTable(L1Inverse);
-            destroyTruthTable(GPrime);
-            destroyTruthTable(L2);
-            destroyTruthTable(currentL1);
-            return;
+bool innerPermutationFirst(Partition *G, Partition *F, size_t n, size_t *basis, size_t *map, TruthTable *functionF,
+                           TruthTable *functionG, SearchControl *control) {
+    // The automorphisms of F act on the outer side, so there is no orbit to break the symmetries of L2 with
+    LeafCheck *leaves = initReverseLeafCheck(functionF, functionG);
+    TreeWalk *walk = initTreeWalk(G, F, n, basis, map, leaves, NULL, control);
+    bool foundSolution = guessValuesOfL(walk, SIZE_MAX) == SEARCH_FOUND;
+    destroyTreeWalk(walk);
+    destroyLeafCheck(leaves);
+    return foundSolution;
+}
+
+/**
+ * Guess ck as the image of basis element k, and derive the images of the new half of the span by linearity: adding
+ * b_k to a linear combination of the previous basis elements adds ck to its image. The derivation stops at the first
+ * contradiction, i.e. an image in the wrong bucket, a bucket of G that has no room left for the image, or, when
+ * breaking symmetries, an element of the orbit of b_1 whose image is smaller than the image of b_1.
+ * @return The number of values derived, 2^k if there was no contradiction
+ */
+static size_t extendSpan(size_t k, size_t ck, const size_t *span, Partition *partitionG, size_t *generated,
+                         bool *generatedImages, size_t *occupancy, size_t *fBucket, size_t *gBucket, size_t *map,
+                         const bool *orbit) {
+    // This is done to handle the special case of k = 0, since otherwise we get (1L << (k - 1)) == MAX_INT.
+    size_t LIMIT = k ? 1L << k : 1;
+    size_t firstImage = k ? generated[span[1]] : ck; // The image of the first basis element
+    size_t filled = 0;
+    for (size_t linearCombination = 0; linearCombination < LIMIT; ++linearCombination) {
+        // The combination plus b_k maps to the image of the combination, which is already known, plus ck
+        size_t x = span[linearCombination | LIMIT];
+        size_t y = generated[span[linearCombination]] ^ ck;
+
+        size_t bucket = gBucket[y];
+        if (map[fBucket[x]] != bucket || occupancy[bucket] == partitionG->bucketSizes[bucket]) break;
+
+        // Some L1 * A maps the first basis element to a smaller image, so that one is searched instead
+        if (orbit != NULL && orbit[x] && y < firstImage) break;
+
+        // Add the new preimage-image pair to the partial truth table, and mark the image as generated
+        generated[x] = y;
+        generatedImages[y] = true;
+        occupancy[bucket] += 1;
+        filled += 1;
+    }
+    return filled;
+}
+
+/**
+ * Undo extendSpan: reset the generated image indicators of the first filled values derived for basis element k
+ */
+static void retractSpan(size_t k, size_t filled, const size_t *span, size_t *generated, bool *generatedImages,
+                        size_t *occupancy, size_t *gBucket) {
+    size_t LIMIT = k ? 1L << k : 1;
+    for (size_t linearCombination = 0; linearCombination < filled; ++linearCombination) {
+        size_t y = generated[span[linearCombination | LIMIT]];
+        generatedImages[y] = false;
+        occupancy[gBucket[y]] -= 1;
+    }
+}
+
+TreeWalk *initTreeWalk(Partition *F, Partition *G, size_t n, const size_t *basis, size_t *map, LeafCheck *leaves,
+                       const bool *orbit, SearchControl *control) {
+    TreeWalk *walk = malloc(sizeof(TreeWalk));
+    walk->n = n;
+    walk->F = F;
+    walk->G = G;
+    walk->basis = basis;
+    walk->span = spanBasis(n, basis);
+    walk->map = map;
+    walk->leaves = leaves;
+    walk->orbit = orbit;
+    walk->control = control;
+    walk->generated = calloc(sizeof(size_t), 1L << n);
+    walk->generatedImages = calloc(sizeof(bool), 1L << n);
+    walk->occupancy = calloc(sizeof(size_t), G->numBuckets);
+    walk->depth = 0;
+    walk->entering = true;
+    walk->next = calloc(sizeof(size_t), n + 1);
+    walk->filled = calloc(sizeof(size_t), n + 1);
+    walk->guessed = NULL;
+    walk->nodes = 0;
+    walk->status = SEARCH_RUNNING;
+
+    // A linear permutation maps 0 -> 0, so 0 must be in the matching bucket, and it is the first generated image
+    if (map[F->bucketOf[0]] == G->bucketOf[0]) {
+        walk->generatedImages[0] = true;
+        walk->occupancy[G->bucketOf[0]] = 1;
+    } else {
+        walk->status = SEARCH_EXHAUSTED;
+    }
+    return walk;
+}
+
+/**
+ * End the check of the leaf on top of the stack, and report the equivalence if there is one
+ * @return True if the leaf is an equivalence
+ */
+static bool endWalkLeaf(TreeWalk *walk) {
+    LeafCheck *leaves = walk->leaves;
+    TruthTable *guessed = walk->guessed;
+    TruthTable *derived = endLeaf(leaves);
+    walk->guessed = NULL;
+    // In reverse, the guessed permutation is L2 and the derived one is L1
+    TruthTable *L1 = leaves->reverse ? derived : guessed;
+    TruthTable *L2 = leaves->reverse ? guessed : derived;
+    // When racing a portfolio, only the first search to find an equivalence reports it
+    if (derived != NULL && winRace(walk->control)) {
+        /* At this point, we know (L1,L2) linear s.t. L1 * orthoderivativeF * L2 = orthoderivativeG */
+        if (!walk->control->muted) {
+            emitMap(leaves->affineSearch ? "A1" : "L1", L1);
+            emitMap(leaves->affineSearch ? "A2" : "L2", L2);
         }
-        destroyTruthTable(currentL1);
-        destroyTruthTable(L1Inverse);
-        destroyTruthTable(GPrime);
-        destroyTruthTable(L2);
+        recordEquivalence(walk->control, L1, L2);
+        return true;
+    }
+    if (derived != NULL) destroyTruthTable(derived);
+    destroyTruthTable(guessed);
+    /* A check that was cut short stops the walk at the leaf, which backtrack leaves in the frontier, so that the
+     * search resumes by checking the leaf again; a leaf in reverse is too short to be cut */
+    if (derived == NULL && !leaves->reverse) searchShouldStopNow(walk->control);
+    return false;
+}
+
+/**
+ * Pop the node on top of the stack, and undo the guess of its parent that led to it. Popping the root ends the walk.
+ */
+static void backtrack(TreeWalk *walk) {
+    if (walk->depth == 0) {
+        walk->status = SEARCH_EXHAUSTED;
         return;
     }
-        /**
-         * We then take the bucket of the same size from the partition with respect to G. We know that the image of the
-         * basis element must belong to that bucket.
-         */
-    size_t posBucketG = map[fBucket[basis[k]]];
+    size_t k = --walk->depth;
+    // Only the first choice at this depth lies on the path restored from a checkpoint
+    walk->control->resuming = false;
+    // When backtracking, we need to reset the generated image indicators of the values we derived
+    retractSpan(k, walk->filled[k], walk->span, walk->generated, walk->generatedImages, walk->occupancy,
+                walk->G->bucketOf);
+    // The search was stopped below us; leave the frontier untouched so that it can be saved
+    if (walk->control->status != SEARCH_RUNNING) walk->status = walk->control->status;
+}
 
-    // We now go through all possible choices from the bucket
-    for (size_t ick = 0; ick < partitionG->bucketSizes[posBucketG]; ++ick) {
-        size_t ck = partitionG->buckets[posBucketG][ick];
+/**
+ * Go through the remaining images of basis element k, from the position where the last one left off, and push the
+ * child of the first image that agrees with the partitions
+ * @return False if no image is left
+ */
+static bool descend(TreeWalk *walk, size_t k) {
+    SearchControl *control = walk->control;
+    Partition *partitionG = walk->G;
+    size_t n = walk->n;
+    /**
+     * We then take the bucket of the same size from the partition with respect to G. We know that the image of the
+     * basis element must belong to that bucket.
+     */
+    size_t posBucketG = walk->map[walk->F->bucketOf[walk->basis[k]]];
+    size_t *bucketG = partitionG->elements + partitionG->offsets[posBucketG];
+    while (walk->next[k] < partitionG->bucketSizes[posBucketG]) {
+        size_t ick = walk->next[k]++;
+        size_t ck = bucketG[ick];
 
         /**
          * Since we want the function to be a permutation, the image of the basis element should not be one of the
          * images that we already generated.
          */
-        if (generatedImages[ck]) continue;
+        if (walk->generatedImages[ck]) continue;
 
-        /**
-         * A contradiction can occur if assigning this value to the basis element causes some other element to map to
-         * the wrong bucket by linearity. The following variable will be set to true if such a contradiction is
-         * encountered.
-         */
-        bool problem = false;
-
-        // This is done to handle the special case of k = 0, since otherwise we get (1L << (k - 1)) == MAX_INT.
-        size_t LIMIT = k ? 1L << k : 1;
+        // When the search space is sharded, the top-level choices may be split between several processes
+        if (k == 0 && !shardOwnsChoice(control, ick)) continue;
 
         /**
-         * We now go trough all linear combinations of the basis elements that have been previously assigned.
-         * Adding the newly guessed basis element to such combination allows us to derive one more value of the
-         * function; if one of these values maps to the wrong bucket, we set "problem" = false, to indicate a
-         * contradiction and backtrack.
+         * A contradiction can occur if assigning this value to the basis element causes some other element to map to
+         * the wrong bucket by linearity. The number of values derived before a contradiction is kept in "filled".
          */
-        for (size_t linearCombination = 0; linearCombination < LIMIT; ++linearCombination) {
-            size_t x = linearCombination ^ basis[k];
-            size_t y = ck;
+        size_t filled = extendSpan(k, ck, walk->span, partitionG, walk->generated, walk->generatedImages,
+                                   walk->occupancy, walk->F->bucketOf, partitionG->bucketOf, walk->map, walk->orbit);
 
-            /**
-             * The following loop simply XOR's all images corresponding to the linear combination, so that we get its
-             * image over linearity.
-             */
-             if (k) {
-                 for (size_t i = 0; i < k; ++i) {
-                     if (1L << i & linearCombination) {
-                         y ^= generated[basis[i]];
-                     }
-                 }
-             }
-
-             // Check for contradiction as described above
-             if (partitionF->bucketSizes[fBucket[x]] != partitionG->bucketSizes[gBucket[y]]) {
-                 problem = true;
-                 break;
-             }
-
-            // Add the new preimage-image pair to the partial truth table of the function
-            generated[x] = y;
-
-            // We also indicate that the image belongs to the set of generated images
-            generatedImages[y] = true;
+        /* Close enough to the leaves, the lookahead checks that some leaf below can still have an inner permutation.
+         * In reverse, the outer permutation is checked at every depth, since that is cheap. */
+        bool consistent = filled == (k ? 1L << k : 1);
+        if (consistent && (walk->leaves->reverse ||
+                           (walk->leaves->tSetsF != NULL && k + 1 < n && k + 1 + control->lookahead >= n))) {
+            consistent = partialLeafPossible(walk->leaves, walk->span, walk->generated, k + 1);
         }
+
         // If no contradiction is encountered, we go to the next basis element
-        if (!problem) {
-            images[k] = ck;
-            guessValuesOfL(k + 1, basis, images, partitionF, partitionG, n, generated, generatedImages, fBucket,
-                           gBucket,
-                           map, foundSolution, functionF, functionG, affineSearch);
+        if (consistent) {
+            control->icks[k] = ick;
+            control->images[k] = ck;
+            walk->filled[k] = filled;
+            walk->depth = k + 1;
+            walk->entering = true;
+            return true;
         }
+        control->resuming = false;
+        retractSpan(k, filled, walk->span, walk->generated, walk->generatedImages, walk->occupancy,
+                    partitionG->bucketOf);
+    }
+    return false;
+}
 
-        // When backtracking, we need to reset the generated image indicators
-        for (size_t linearCombinations = 0; linearCombinations < LIMIT; ++linearCombinations) {
-            size_t y = ck;
-            if (k) {
-                for (size_t i = 0; i < k; ++i) {
-                    if (1L << i & linearCombinations) {
-                        y ^= generated[basis[i]];
-                    }
+SearchStatus guessValuesOfL(TreeWalk *walk, size_t budget) {
+    SearchControl *control = walk->control;
+    size_t expanded = 0;
+    while (walk->status == SEARCH_RUNNING) {
+        size_t k = walk->depth;
+        // The leaf on top of the stack is being checked, and its search for L2 goes on with what is left of the budget
+        if (walk->guessed != NULL) {
+            size_t spent = 0;
+            SearchStatus leaf = stepLeaf(walk->leaves, budget - expanded, &spent);
+            expanded += spent;
+            walk->nodes += spent;
+            if (leaf == SEARCH_RUNNING) break;
+            if (endWalkLeaf(walk)) {
+                walk->status = SEARCH_FOUND;
+            } else {
+                backtrack(walk);
+            }
+            continue;
+        }
+        if (walk->entering) {
+            if (expanded == budget) break;
+            expanded += 1;
+            walk->nodes += 1;
+            walk->entering = false;
+            // Record where we are, so that a checkpoint written from here resumes at this node
+            control->depth = k;
+            if (searchShouldStop(control)) {
+                walk->status = control->status;
+                break;
+            }
+            /**
+             * If all basis elements have been assigned an image, and no contradictions have occurs, then we have found
+             * a linear permutation preserving the partition. We reconstruct its truth table, and check for an inner
+             * permutation.
+             */
+            if (k == walk->n) {
+                walk->guessed = initTruthTable(k);
+                memcpy(walk->guessed->elements, walk->generated, sizeof(size_t) * 1L << k);
+                if (beginLeaf(walk->leaves, walk->guessed, control) == SEARCH_RUNNING) continue;
+                if (endWalkLeaf(walk)) {
+                    walk->status = SEARCH_FOUND;
+                } else {
+                    backtrack(walk);
                 }
+                continue;
             }
-            generatedImages[y] = false;
+            // Every element of the bucket is already the image of some element of the span, so no image is left
+            size_t posBucketG = walk->map[walk->F->bucketOf[walk->basis[k]]];
+            if (walk->occupancy[posBucketG] == walk->G->bucketSizes[posBucketG]) {
+                backtrack(walk);
+                continue;
+            }
+            if (k == 0) control->topChoices = walk->G->bucketSizes[posBucketG];
+            // We now go through all possible choices from the bucket, starting where the checkpoint left off
+            walk->next[k] = resumePosition(control, k);
         }
+        if (!descend(walk, k)) backtrack(walk);
     }
+    return walk->status;
 }
 
-size_t *createBucketRepresentation(Partition *F, size_t n) {
-    // Loop over each bucket and set the bucket pos for each value
-    size_t *class = malloc(sizeof(size_t) * 1L << n);
-    for (size_t i = 0; i < F->numBuckets; ++i) {
-        for (size_t j = 0; j < F->bucketSizes[i]; ++j) {
-            size_t value = F->buckets[i][j];
-            class[value] = i; // Set the bucket number in the position of the value
+void destroyTreeWalk(TreeWalk *walk) {
+    if (walk->guessed != NULL) {
+        TruthTable *derived = endLeaf(walk->leaves);
+        if (derived != NULL) destroyTruthTable(derived);
+        destroyTruthTable(walk->guessed);
+    }
+    free(walk->span);
+    free(walk->generated);
+    free(walk->generatedImages);
+    free(walk->occupancy);
+    free(walk->next);
+    free(walk->filled);
+    free(walk);
+}
+
+void estimateSearchTree(Partition *F, Partition *G, size_t n, size_t *basis, size_t *map, TruthTable *functionF,
+                        TruthTable *functionG, bool affineSearch, bool reverse, const bool *orbit, size_t lookahead,
+                        size_t probes, TreeEstimate *estimate) {
+    size_t *generated = calloc(sizeof(size_t), 1L << n);
+    bool *generatedImages = calloc(sizeof(bool), 1L << n);
+    size_t *occupancy = calloc(sizeof(size_t), G->numBuckets);
+    size_t *children = malloc(sizeof(size_t) * 1L << n); // The images of b_k that lead to a child of the node
+    size_t *span = spanBasis(n, basis);
+    TruthTable *L1 = initTruthTable(n);
+    LeafCheck *leafCheck = reverse ? initReverseLeafCheck(functionF, functionG) :
+                           initLeafCheck(functionF, functionG, basis, affineSearch, lookahead > 0);
+    double nodes = 0, leaves = 0, nodeSeconds = 0, leafSeconds = 0;
+    size_t timedLeaves = 0;
+    if (map[F->bucketOf[0]] != G->bucketOf[0]) probes = 0;
+
+    /* Knuth's estimator: walk down a random path, choosing a child uniformly at each node. A node at depth k on the
+     * path stands for the product of the numbers of children of its ancestors, on average. */
+    for (size_t probe = 0; probe < probes; ++probe) {
+        memset(generatedImages, 0, sizeof(bool) * 1L << n);
+        memset(occupancy, 0, sizeof(size_t) * G->numBuckets);
+        generatedImages[0] = true;
+        occupancy[G->bucketOf[0]] = 1;
+        double weight = 1;
+        nodes += 1;
+        for (size_t k = 0; k <= n; ++k) {
+            if (k == n) {
+                leaves += weight;
+                // Checking a leaf costs about the same for every leaf, so only the first few are timed
+                if (timedLeaves < 8) {
+                    clock_t start = clock();
+                    memcpy(L1->elements, generated, sizeof(size_t) * 1L << n);
+                    TruthTable *L2 = checkLeaf(leafCheck, L1, NULL);
+                    if (L2 != NULL) destroyTruthTable(L2);
+                    leafSeconds += (double) (clock() - start) / CLOCKS_PER_SEC;
+                    timedLeaves += 1;
+                }
+                break;
+            }
+            clock_t start = clock();
+            size_t posBucketG = map[F->bucketOf[basis[k]]];
+            size_t *bucketG = G->elements + G->offsets[posBucketG];
+            size_t numChildren = 0;
+            for (size_t ick = 0; ick < G->bucketSizes[posBucketG]; ++ick) {
+                size_t ck = bucketG[ick];
+                if (generatedImages[ck]) continue;
+                size_t filled = extendSpan(k, ck, span, G, generated, generatedImages, occupancy, F->bucketOf,
+                                           G->bucketOf, map, orbit);
+                bool consistent = filled == (k ? 1L << k : 1);
+                if (consistent && (reverse || (lookahead > 0 && k + 1 < n && k + 1 + lookahead >= n))) {
+                    consistent = partialLeafPossible(leafCheck, span, generated, k + 1);
+                }
+                if (consistent) children[numChildren++] = ck;
+                retractSpan(k, filled, span, generated, generatedImages, occupancy, G->bucketOf);
+            }
+            nodeSeconds += weight * (double) (clock() - start) / CLOCKS_PER_SEC;
+            if (numChildren == 0) break;
+
+            weight *= (double) numChildren;
+            nodes += weight;
+            extendSpan(k, children[rand() % numChildren], span, G, generated, generatedImages, occupancy,
+                       F->bucketOf, G->bucketOf, map, orbit);
         }
     }
-    return class;
+
+    if (probes > 0) {
+        estimate->nodes += nodes / probes;
+        estimate->leaves += leaves / probes;
+        estimate->seconds += nodeSeconds / probes;
+        if (timedLeaves > 0) estimate->seconds += leaves / probes * leafSeconds / timedLeaves;
+    }
+    destroyLeafCheck(leafCheck);
+    destroyTruthTable(L1);
+    free(span);
+    free(children);
+    free(generated);
+    free(generatedImages);
+    free(occupancy);
 }
 
-bool *computeSetOfTs(TruthTable *F, const size_t x) {
+void computeSetOfTs(TruthTable *F, const size_t x, uint64_t *tSet) {
     size_t dimension = F->n;
-    bool *map = calloc(sizeof(bool), 1L << dimension);
+    memset(tSet, 0, sizeof(uint64_t) * bitsetWords(dimension));
     for (size_t y = 0; y < 1L << dimension; ++y) {
         size_t t = F->elements[x] ^ F->elements[y] ^ F->elements[x ^ y];
-        map[t] = true;
+        tSet[t / 64] |= 1ULL << (t % 64);
     }
-    return map;
 }
 
-Node *computeRestrictedDomains(TruthTable *F, const bool *map) {
+Partition *partitionInputs(TruthTable *F) {
+    size_t n = F->n;
+    size_t *occurrences = calloc(sizeof(size_t), 1L << n);
+    size_t *keys = malloc(sizeof(size_t) * 1L << n);
+    uint64_t *tSet = malloc(sizeof(uint64_t) * bitsetWords(n));
+    countElements(F, occurrences);
+    for (size_t x = 0; x < 1L << n; ++x) {
+        computeSetOfTs(F, x, tSet);
+        size_t size = 0;
+        for (size_t w = 0; w < bitsetWords(n); ++w) {
+            size += __builtin_popcountll(tSet[w]);
+        }
+        keys[x] = size * ((1L << n) + 1) + occurrences[F->elements[x]];
+    }
+    Partition *partition = initPartition(n);
+    fillPartitionByKeys(partition, keys);
+    free(tSet);
+    free(keys);
+    free(occurrences);
+    return partition;
+}
+
+/**
+ * Compute the restricted domains as computeRestrictedDomains does, reading the t-sets of F from tSetsF if they are kept
+ * @return False if the search was asked to stop before the domains were complete
+ */
+static bool restrictDomains(TruthTable *F, const uint64_t *tSetsF, const uint64_t *tSets, size_t count,
+                            size_t *domains, size_t *sizes, SearchControl *control) {
     size_t dimension = F->n;
-    bool *domain = calloc(sizeof(bool), 1L << dimension);
-    for (size_t i = 0; i < 1L << dimension; ++i) {
-        domain[i] = true;
-    }
-    for (size_t t = 0; t < 1L << dimension; ++t) {
-        if (map[t]) {
-            bool *tempSet = calloc(sizeof(bool), 1L << dimension);
-            for (size_t x = 0; x < 1L << dimension; ++x) {
-                for (size_t y = 0; y < 1L << dimension; ++y) {
-                    if (t == (F->elements[x] ^ F->elements[y] ^ F->elements[x ^ y])) {
-                        tempSet[x] = true;
-                        tempSet[y] = true;
-                        tempSet[x ^ y] = true;
-                    }
-                }
+    size_t words = bitsetWords(dimension);
+    uint64_t *tSetF = tSetsF == NULL ? malloc(sizeof(uint64_t) * words) : NULL;
+    memset(sizes, 0, sizeof(size_t) * count);
+    /* F(x) + F(y) + F(x + y) is symmetric in the three elements x, y and x + y, so x takes part in a triple giving t
+     * if and only if t is in the set of T's of F at x. One pass over x then serves all the t's of all the sets. */
+    bool complete = true;
+    for (size_t x = 1L << dimension; x-- > 0;) {
+        // Without the t-sets of F kept, each x takes 2^n steps, which is long enough to poll the search every time
+        if (control != NULL && tSetsF == NULL && searchStopRequested(control)) {
+            complete = false;
+            break;
+        }
+        const uint64_t *tSetOfX = tSetF;
+        if (tSetsF == NULL) {
+            computeSetOfTs(F, x, tSetF);
+        } else {
+            tSetOfX = tSetsF + x * words;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (subsetOf(tSets + i * words, tSetOfX, words)) {
+                domains[(i << dimension) + sizes[i]++] = x;
+            }
+        }
+    }
+    free(tSetF);
+    return complete;
+}
+
+void computeRestrictedDomains(TruthTable *F, const uint64_t *tSets, size_t count, size_t *domains, size_t *sizes) {
+    restrictDomains(F, NULL, tSets, count, domains, sizes, NULL);
+}
+
+/**
+ * Index the pre-images of all values of F: the pre-images of y are preimages[offsets[y]] up to
+ * preimages[offsets[y + 1] - 1]
+ */
+static void indexPreimages(TruthTable *F, size_t *offsets, size_t *preimages) {
+    size_t entries = 1L << F->n;
+    memset(offsets, 0, sizeof(size_t) * (entries + 1));
+    for (size_t x = 0; x < entries; ++x) {
+        offsets[F->elements[x] + 1] += 1;
+    }
+    for (size_t y = 0; y < entries; ++y) {
+        offsets[y + 1] += offsets[y];
+    }
+    for (size_t x = 0; x < entries; ++x) {
+        preimages[offsets[F->elements[x]]++] = x;
+    }
+    // Placing the pre-images moved every offset to the start of the next value
+    for (size_t y = entries; y > 0; --y) {
+        offsets[y] = offsets[y - 1];
+    }
+    offsets[0] = 0;
+}
+
+/**
+ * Set up the domains of the search for G: the image of basis element b_i must lie in the restricted domain of b_i, and
+ * must be a pre-image of G(b_i) under F.
+ */
+static void initInnerDomains(InnerSearch *search, const size_t *restricted, const size_t *restrictedSizes,
+                             const size_t *basis) {
+    size_t dimension = search->n;
+    bool *marks = search->marks;
+    for (size_t i = 0; i < dimension; ++i) {
+        size_t y = search->G->elements[basis[i] ^ search->offset];
+        for (size_t j = search->preimageOffsets[y]; j < search->preimageOffsets[y + 1]; ++j) {
+            marks[search->preimages[j]] = true;
+        }
+        size_t size = 0;
+        const size_t *domain = restricted + (i << dimension);
+        for (size_t j = 0; j < restrictedSizes[i]; ++j) {
+            if (marks[domain[j]]) {
+                search->domains[i][size] = domain[j];
+                search->removedAt[i][size] = SIZE_MAX;
+                size += 1;
             }
-            for (size_t i = 0; i < 1L << dimension; ++i) {
-                domain[i] &= tempSet[i];
+        }
+        search->domainSizes[i] = size;
+        search->alive[i] = size;
+        search->assigned[i] = false;
+        for (size_t j = search->preimageOffsets[y]; j < search->preimageOffsets[y + 1]; ++j) {
+            marks[search->preimages[j]] = false;
+        }
+    }
+    resetPoints(search->L2, 1);
+    search->depth = 0;
+    search->entering = true;
+}
+
+/**
+ * Allocate the state of a search for L2 in dimension n. The domains start empty and grow with the restricted domains
+ * they are given, so that the same state can serve the searches of many leaves.
+ */
+static void initInnerSearch(InnerSearch *search, size_t dimension) {
+    search->n = dimension;
+    search->domains = calloc(sizeof(size_t *), dimension);
+    search->removedAt = calloc(sizeof(size_t *), dimension);
+    search->capacities = calloc(sizeof(size_t), dimension);
+    search->domainSizes = malloc(sizeof(size_t) * dimension);
+    search->alive = malloc(sizeof(size_t) * dimension);
+    search->assigned = malloc(sizeof(bool) * dimension);
+    search->marks = calloc(sizeof(bool), 1L << dimension);
+    search->L2 = initPartialLinearMap(dimension);
+    search->offset = 0;
+    search->candidate = 0;
+    search->firstFound = NULL;
+    search->order = malloc(sizeof(size_t) * dimension);
+    search->next = malloc(sizeof(size_t) * dimension);
+    search->counts = malloc(sizeof(size_t) * dimension);
+    search->active = false;
+    search->nodes = 0;
+}
+
+/**
+ * Point the state of a search for L2 at the functions, the index of the pre-images of F and the restricted domains of
+ * one leaf, growing the domains where the restricted domains do not fit
+ */
+static void targetInnerSearch(InnerSearch *search, TruthTable *F, TruthTable *G, const size_t *basis,
+                              size_t *preimageOffsets, size_t *preimages, const size_t *restrictedSizes,
+                              SearchControl *control) {
+    search->F = F;
+    search->G = G;
+    search->offset = 0;
+    search->basis = basis;
+    search->preimageOffsets = preimageOffsets;
+    search->preimages = preimages;
+    search->control = control;
+    for (size_t i = 0; i < search->n; ++i) {
+        if (restrictedSizes[i] + 1 > search->capacities[i]) {
+            search->capacities[i] = restrictedSizes[i] + 1;
+            search->domains[i] = realloc(search->domains[i], sizeof(size_t) * search->capacities[i]);
+            search->removedAt[i] = realloc(search->removedAt[i], sizeof(size_t) * search->capacities[i]);
+        }
+    }
+}
+
+/**
+ * Free the memory allocated by initInnerSearch
+ */
+static void clearInnerSearch(InnerSearch *search) {
+    for (size_t i = 0; i < search->n; ++i) {
+        free(search->domains[i]);
+        free(search->removedAt[i]);
+    }
+    free(search->domains);
+    free(search->removedAt);
+    free(search->capacities);
+    free(search->domainSizes);
+    free(search->alive);
+    free(search->assigned);
+    free(search->marks);
+    free(search->order);
+    free(search->next);
+    free(search->counts);
+    destroyPartialLinearMap(search->L2);
+}
+
+/**
+ * The constants c2 of the inner permutation of a leaf, searched on several threads. The candidates are handed out in
+ * order, and a search stops as soon as a smaller candidate is known to succeed, so that the result is the one the
+ * sequential sweep finds. A linear inner permutation is the sweep of the single constant 0. The sweep is run in
+ * rounds, between which every thread keeps the search of the constant it holds.
+ */
+typedef struct OffsetSweep {
+    const size_t *candidates; // The constants c2 to try, the pre-images of G(0) under F
+    size_t count; // Number of candidates
+    size_t next; // The next candidate to hand out
+    size_t firstFound; // Index of the smallest candidate that succeeded, count if none did yet; read atomically
+    TruthTable *L2; // The inner permutation found for that candidate
+    pthread_mutex_t lock; // Protects next, firstFound and L2
+    TruthTable *F; // The function F
+    TruthTable *G; // The function G', owned by the sweep
+    const size_t *basis; // The basis
+    size_t *preimageOffsets; // The index of the pre-images of F
+    size_t *preimages; // The pre-images of F
+    const size_t *restricted; // The restricted domains of the basis elements
+    const size_t *restrictedSizes; // The number of elements in each restricted domain
+    SearchControl *control; // Polled by the searches, NULL if the sweep cannot be stopped
+    SweepPool *pool; // The pool of the control, NULL if the sweep runs on its own state of the search
+    InnerSearch *own; // The state of the search of a sweep without a pool
+} OffsetSweep;
+
+/**
+ * Expand the nodes of the candidates of a sweep on the state of the search of the calling thread, going on with the
+ * candidate it holds and taking the next ones as long as they are handed out
+ * @return The number of nodes expanded, at most the budget
+ */
+static size_t sweepOffsets(OffsetSweep *sweep, InnerSearch *search, size_t budget) {
+    size_t spent = 0;
+    while (spent < budget) {
+        if (!search->active) {
+            pthread_mutex_lock(&sweep->lock);
+            size_t candidate = sweep->next++;
+            pthread_mutex_unlock(&sweep->lock);
+            if (candidate >= sweep->count || candidate > __atomic_load_n(&sweep->firstFound, __ATOMIC_ACQUIRE)) break;
+            if (sweep->control != NULL && searchStopRequested(sweep->control)) break;
+
+            targetInnerSearch(search, sweep->F, sweep->G, sweep->basis, sweep->preimageOffsets, sweep->preimages,
+                              sweep->restrictedSizes, sweep->control);
+            search->firstFound = &sweep->firstFound;
+            search->candidate = candidate;
+            search->offset = sweep->candidates[candidate];
+            initInnerDomains(search, sweep->restricted, sweep->restrictedSizes, sweep->basis);
+            search->active = true;
+        }
+        size_t nodes = search->nodes;
+        SearchStatus status = dfs(search, budget - spent);
+        spent += search->nodes - nodes;
+        if (status == SEARCH_RUNNING) break;
+        search->active = false;
+        if (status == SEARCH_FOUND) {
+            pthread_mutex_lock(&sweep->lock);
+            if (search->candidate < sweep->firstFound) {
+                __atomic_store_n(&sweep->firstFound, search->candidate, __ATOMIC_RELEASE);
+                memcpy(sweep->L2->elements, search->L2->values, sizeof(size_t) * 1L << search->n);
             }
-            free(tempSet);
+            pthread_mutex_unlock(&sweep->lock);
+            break;
+        }
+    }
+    return spent;
+}
+
+/**
+ * The threads that search the constants c2 of the leaves of one search, started at its first leaf and kept until the
+ * search is destroyed. Each thread keeps its own state of the search for L2, so that a leaf allocates nothing.
+ */
+struct SweepPool {
+    size_t threads; // Number of threads of a sweep, including the thread of the search
+    InnerSearch *searches; // The state of the search of each thread, the one of the search first
+    pthread_t *workers; // The threads - 1 workers
+    struct SweepWorker *slots; // The argument of each worker
+    pthread_mutex_t lock; // Protects the fields below
+    pthread_cond_t handedOut; // Signalled when a round is handed out, or when the pool shuts down
+    pthread_cond_t finished; // Signalled when the last worker is done with the round
+    OffsetSweep *sweep; // The sweep of the round handed out last
+    size_t quota; // The number of nodes each thread may expand in the round
+    size_t spent; // The number of nodes the workers expanded in the round
+    size_t generation; // Number of rounds handed out so far
+    size_t busy; // Number of workers still working on the round handed out last
+    bool shutdown; // True once the workers should exit
+};
+
+/**
+ * A worker of a pool, together with the index of its state of the search
+ */
+typedef struct SweepWorker {
+    SweepPool *pool; // The pool
+    size_t index; // Index of the state of the search of the worker
+} SweepWorker;
+
+static void *sweepWorker(void *argument) {
+    SweepWorker *worker = argument;
+    SweepPool *pool = worker->pool;
+    size_t seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (pool->generation == seen && !pool->shutdown) {
+            pthread_cond_wait(&pool->handedOut, &pool->lock);
         }
+        if (pool->shutdown) break;
+        seen = pool->generation;
+        OffsetSweep *sweep = pool->sweep;
+        size_t quota = pool->quota;
+        pthread_mutex_unlock(&pool->lock);
+        size_t spent = sweepOffsets(sweep, &pool->searches[worker->index], quota);
+        pthread_mutex_lock(&pool->lock);
+        pool->spent += spent;
+        if (--pool->busy == 0) pthread_cond_signal(&pool->finished);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * Find the pool of a search, starting it at the first leaf
+ */
+static SweepPool *sweepPool(SearchControl *control, size_t dimension) {
+    if (control->sweepPool != NULL) return control->sweepPool;
+    SweepPool *pool = malloc(sizeof(SweepPool));
+    pool->threads = control->threads > 0 ? control->threads : 1;
+    pool->searches = malloc(sizeof(InnerSearch) * pool->threads);
+    for (size_t t = 0; t < pool->threads; ++t) {
+        initInnerSearch(&pool->searches[t], dimension);
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->handedOut, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+    pool->sweep = NULL;
+    pool->quota = 0;
+    pool->spent = 0;
+    pool->generation = 0;
+    pool->busy = 0;
+    pool->shutdown = false;
+    pool->workers = malloc(sizeof(pthread_t) * pool->threads);
+    pool->slots = malloc(sizeof(SweepWorker) * pool->threads);
+    for (size_t t = 1; t < pool->threads; ++t) {
+        pool->slots[t].pool = pool;
+        pool->slots[t].index = t;
+        pthread_create(&pool->workers[t], NULL, sweepWorker, &pool->slots[t]);
     }
-    Node *domainResult = initNode();
-    for (size_t i = 0; i < 1L << dimension; ++i) {
-        if (domain[i]) {
-            addNode(domainResult, i);
+    control->sweepPool = pool;
+    return pool;
+}
+
+/**
+ * Run a round of a sweep on all the threads of its pool, each with its share of the budget, and return once they are
+ * all done with it
+ * @return The number of nodes expanded by all the threads
+ */
+static size_t runSweep(OffsetSweep *sweep, size_t budget) {
+    SweepPool *pool = sweep->pool;
+    if (pool == NULL) return sweepOffsets(sweep, sweep->own, budget);
+    // A single candidate gains nothing from waking the workers
+    if (pool->threads == 1 || sweep->count <= 1) return sweepOffsets(sweep, &pool->searches[0], budget);
+    size_t quota = budget / pool->threads > 0 ? budget / pool->threads : 1;
+    pthread_mutex_lock(&pool->lock);
+    pool->sweep = sweep;
+    pool->quota = quota;
+    pool->spent = 0;
+    pool->busy = pool->threads - 1;
+    pool->generation += 1;
+    pthread_cond_broadcast(&pool->handedOut);
+    pthread_mutex_unlock(&pool->lock);
+    size_t spent = sweepOffsets(sweep, &pool->searches[0], quota);
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    }
+    spent += pool->spent;
+    pthread_mutex_unlock(&pool->lock);
+    return spent;
+}
+
+/**
+ * Check if a sweep is over between two rounds: every candidate was handed out, or a smaller one succeeded, and no
+ * thread holds a candidate any more
+ */
+static bool sweepOver(OffsetSweep *sweep) {
+    size_t threads = sweep->pool != NULL ? sweep->pool->threads : 1;
+    InnerSearch *searches = sweep->pool != NULL ? sweep->pool->searches : sweep->own;
+    for (size_t t = 0; t < threads; ++t) {
+        if (searches[t].active) return false;
+    }
+    return sweep->next >= sweep->count || sweep->next > sweep->firstFound;
+}
+
+void destroySweepPool(SweepPool *pool) {
+    if (pool == NULL) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->handedOut);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t t = 1; t < pool->threads; ++t) {
+        pthread_join(pool->workers[t], NULL);
+    }
+    for (size_t t = 0; t < pool->threads; ++t) {
+        clearInnerSearch(&pool->searches[t]);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->handedOut);
+    pthread_cond_destroy(&pool->finished);
+    free(pool->searches);
+    free(pool->workers);
+    free(pool->slots);
+    free(pool);
+}
+
+/**
+ * The constant 0, the only candidate of a linear inner permutation
+ */
+static const size_t LINEAR_OFFSET = 0;
+
+/**
+ * Set up the search for L2 with F * L2 = G once the restricted domains and the pre-images of F are known. With a
+ * control, the search runs on the pool of the control, otherwise on a state of its own on the calling thread.
+ * @return A new sweep, which owns G
+ */
+static OffsetSweep *beginSweep(LeafCheck *check, TruthTable *G, SearchControl *control) {
+    size_t dimension = check->n;
+    OffsetSweep *sweep = malloc(sizeof(OffsetSweep));
+    if (check->affineSearch) {
+        /* Guess of constant term of L2: F(c2) must be G(0), so the candidates are the pre-images of G(0). G is read
+         * through the offset, as G(x + c2), instead of being translated. */
+        size_t constant_term = G->elements[0];
+        sweep->candidates = check->preimages + check->preimageOffsets[constant_term];
+        sweep->count = check->preimageOffsets[constant_term + 1] - check->preimageOffsets[constant_term];
+    } else {
+        sweep->candidates = &LINEAR_OFFSET;
+        sweep->count = 1;
+    }
+    sweep->next = 0;
+    sweep->firstFound = sweep->count;
+    sweep->L2 = initTruthTable(dimension);
+    pthread_mutex_init(&sweep->lock, NULL);
+    sweep->F = check->F;
+    sweep->G = G;
+    sweep->basis = check->basis;
+    sweep->preimageOffsets = check->preimageOffsets;
+    sweep->preimages = check->preimages;
+    sweep->restricted = check->restricted;
+    sweep->restrictedSizes = check->restrictedSizes;
+    sweep->control = control;
+    sweep->pool = control != NULL ? sweepPool(control, dimension) : NULL;
+    sweep->own = NULL;
+    if (sweep->pool != NULL) {
+        // The states of the pool may still hold the candidates of a leaf that was given up
+        for (size_t t = 0; t < sweep->pool->threads; ++t) {
+            sweep->pool->searches[t].active = false;
         }
+    } else {
+        sweep->own = malloc(sizeof(InnerSearch));
+        initInnerSearch(sweep->own, dimension);
     }
-    free(domain);
-    return domainResult;
+    return sweep;
 }
 
 bool innerPermutation(TruthTable *F, TruthTable *G, const size_t *basis, TruthTable *L2, bool affineSearch) {
-    size_t dimension = F->n;
-    Node **restrictedDomains = malloc(sizeof(Node **) * (dimension + 1));
-    bool result;
+    LeafCheck *check = initLeafCheck(F, G, basis, affineSearch, false);
+    computeRestrictedDomains(F, check->tSetsG, F->n, check->restricted, check->restrictedSizes);
+    TruthTable *copy = initTruthTable(F->n);
+    memcpy(copy->elements, G->elements, sizeof(size_t) * 1L << F->n);
+    check->sweep = beginSweep(check, copy, NULL);
+    size_t spent = 0;
+    bool result = stepLeaf(check, SIZE_MAX, &spent) == SEARCH_FOUND;
+    TruthTable *found = endLeaf(check);
+    if (result) memcpy(L2->elements, found->elements, sizeof(size_t) * 1L << F->n);
+    if (found != NULL) destroyTruthTable(found);
+    destroyLeafCheck(check);
+    return result;
+}
 
-    for (size_t i = 0; i < dimension; ++i) {
-        bool *map = computeSetOfTs(G, basis[i]);
-        restrictedDomains[i] = computeRestrictedDomains(F, map);
-        free(map);
+LeafCheck *initLeafCheck(TruthTable *F, TruthTable *G, const size_t *basis, bool affineSearch, bool lookahead) {
+    size_t n = F->n;
+    LeafCheck *check = malloc(sizeof(LeafCheck));
+    check->n = n;
+    check->F = F;
+    check->G = G;
+    check->basis = basis;
+    check->affineSearch = affineSearch;
+    check->words = bitsetWords(n);
+    check->tSetsG = malloc(sizeof(uint64_t) * n * check->words);
+    check->tSets = malloc(sizeof(uint64_t) * n * check->words);
+    for (size_t i = 0; i < n; ++i) {
+        computeSetOfTs(G, basis[i], check->tSetsG + i * check->words);
     }
+    check->tSetsF = NULL;
+    if (lookahead) {
+        check->tSetsF = malloc(sizeof(uint64_t) * check->words << n);
+        for (size_t x = 0; x < 1L << n; ++x) {
+            computeSetOfTs(F, x, check->tSetsF + x * check->words);
+        }
+    }
+    check->targets = malloc(sizeof(size_t) * n);
+    check->restricted = malloc(sizeof(size_t) * n << n);
+    check->restrictedSizes = malloc(sizeof(size_t) * n);
+    check->preimageOffsets = malloc(sizeof(size_t) * ((1L << n) + 1));
+    check->preimages = malloc(sizeof(size_t) * 1L << n);
+    indexPreimages(F, check->preimageOffsets, check->preimages);
+    check->reverse = false;
+    check->outer = NULL;
+    check->sweep = NULL;
+    check->derived = NULL;
+    return check;
+}
 
-    size_t *values = malloc(sizeof(size_t) * dimension);
+LeafCheck *initReverseLeafCheck(TruthTable *F, TruthTable *G) {
+    LeafCheck *check = calloc(sizeof(LeafCheck), 1);
+    check->n = F->n;
+    check->F = F;
+    check->G = G;
+    check->words = bitsetWords(F->n);
+    check->reverse = true;
+    check->outer = initPartialLinearMap(F->n);
+    return check;
+}
 
-    size_t constant_term = G->elements[0];
-    /* Guess of constant term of L2 */
+/**
+ * Derive the outer permutation from the inner permutation L2 on the span of the first k basis elements, as the linear
+ * map with F(L2(x)) -> G(x). The span holds 2^k points, so the whole span is added again at each node.
+ * @return False if the pairs do not fit a linear permutation
+ */
+static bool deriveOuterPermutation(LeafCheck *check, const size_t *span, const size_t *generated, size_t k) {
+    PartialLinearMap *L1 = check->outer;
+    resetPoints(L1, 1);
+    for (size_t c = 0; c < 1L << k; ++c) {
+        size_t x = span[c];
+        if (!addPoint(L1, check->F->elements[generated[x]], check->G->elements[x])) return false;
+    }
+    return true;
+}
 
-    if (affineSearch) {
-        for (size_t c2 = 0; c2 < 1L << dimension; ++c2) {
-            /* Only consider preimages of G(0) */
-            if (F->elements[c2] != constant_term) {
-                continue;
-            }
+/**
+ * Check a complete inner permutation L2 for an outer permutation L1 with L1 * F * L2 = G. The pairs F(L2(x)) -> G(x)
+ * only fix L1 on the span of the values of F; the rest of L1 is completed with the smallest images that keep it a
+ * permutation, since L1 is free there.
+ */
+static TruthTable *checkReverseLeaf(LeafCheck *check, TruthTable *L2) {
+    size_t n = check->n;
+    PartialLinearMap *L1 = check->outer;
+    resetPoints(L1, 1);
+    for (size_t x = 0; x < 1L << n; ++x) {
+        if (!addPoint(L1, check->F->elements[L2->elements[x]], check->G->elements[x])) return NULL;
+    }
+    // An image outside the span of the images so far can never collide, so the first unused one is taken
+    for (size_t i = 0; i < n; ++i) {
+        if (L1->known[1L << i]) continue;
+        size_t image = 1;
+        while (L1->usedImages[image]) ++image;
+        addPoint(L1, 1L << i, image);
+    }
+    TruthTable *result = initTruthTable(n);
+    memcpy(result->elements, L1->values, sizeof(size_t) * 1L << n);
+    return result;
+}
+
+SearchStatus beginLeaf(LeafCheck *check, TruthTable *L1, SearchControl *control) {
+    if (check->reverse) {
+        check->derived = checkReverseLeaf(check, L1);
+        return check->derived != NULL ? SEARCH_FOUND : SEARCH_EXHAUSTED;
+    }
+    size_t n = check->n;
+    size_t words = check->words;
+    TruthTable *L1Inverse = inverse(L1); // L1^{-1}
 
-            TruthTable *newG = initTruthTable(dimension);
-            for (size_t x = 0; x < 1L << dimension; ++x) {
-                newG->elements[x ^ c2] = G->elements[x];
+    // The t-set of G' = L1^{-1} * G at b_i is L1^{-1} applied to the t-set of G at b_i
+    memset(check->tSets, 0, sizeof(uint64_t) * n * words);
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t *tSetG = check->tSetsG + i * words;
+        uint64_t *tSet = check->tSets + i * words;
+        for (size_t w = 0; w < words; ++w) {
+            for (uint64_t word = tSetG[w]; word != 0; word &= word - 1) {
+                size_t t = L1Inverse->elements[w * 64 + __builtin_ctzll(word)];
+                tSet[t / 64] |= 1ULL << (t % 64);
             }
+        }
+    }
+    bool possible = restrictDomains(check->F, check->tSetsF, check->tSets, n, check->restricted, check->restrictedSizes,
+                                    control);
 
-            result = dfs(restrictedDomains, 0, values, F, newG, L2, basis);
-            if (result) {
-                /* If we get a result, we have to add the constant to the linear function that we found in dfs, and check if
-             * F * l2 + c = G */
-                if (c2 != 0) {
-                    for (int x = 0; x < 1L << dimension; ++x) {
-                        L2->elements[x] ^= c2;
-                    }
-                }
+    // A basis element without any possible image rules out L2 before G' is needed
+    for (size_t i = 0; i < n; ++i) {
+        possible &= check->restrictedSizes[i] > 0;
+    }
+    if (possible) check->sweep = beginSweep(check, compose(L1Inverse, check->G), control); // L1^{-1} * G = G'
+    destroyTruthTable(L1Inverse);
+    return possible ? SEARCH_RUNNING : SEARCH_EXHAUSTED;
+}
 
-                /* If everything went smoothly, we should have aPrime == G */
-                TruthTable *aPrime = compose(F, L2);
+SearchStatus stepLeaf(LeafCheck *check, size_t budget, size_t *spent) {
+    OffsetSweep *sweep = check->sweep;
+    size_t expanded = 0;
+    while (expanded < budget) {
+        expanded += runSweep(sweep, budget - expanded);
+        bool stopped = sweep->control != NULL && searchStopRequested(sweep->control);
+        if (!stopped && !sweepOver(sweep)) continue;
+        *spent += expanded;
+        if (stopped || sweep->firstFound == sweep->count) return SEARCH_EXHAUSTED;
+        /* If we get a result, we have to add the constant to the linear function that we found in dfs, so that
+         * F * l2 + c = G */
+        size_t c2 = sweep->candidates[sweep->firstFound];
+        for (size_t x = 0; x < 1L << check->n; ++x) {
+            sweep->L2->elements[x] ^= c2;
+        }
+        check->derived = sweep->L2;
+        sweep->L2 = NULL;
+        return SEARCH_FOUND;
+    }
+    *spent += expanded;
+    return SEARCH_RUNNING;
+}
 
-                destroyTruthTable(aPrime);
-                destroyTruthTable(newG);
-                break;
+TruthTable *endLeaf(LeafCheck *check) {
+    OffsetSweep *sweep = check->sweep;
+    if (sweep != NULL) {
+        if (sweep->L2 != NULL) destroyTruthTable(sweep->L2);
+        if (sweep->own != NULL) {
+            clearInnerSearch(sweep->own);
+            free(sweep->own);
+        }
+        destroyTruthTable(sweep->G);
+        pthread_mutex_destroy(&sweep->lock);
+        free(sweep);
+        check->sweep = NULL;
+    }
+    TruthTable *derived = check->derived;
+    check->derived = NULL;
+    return derived;
+}
+
+TruthTable *checkLeaf(LeafCheck *check, TruthTable *L1, SearchControl *control) {
+    size_t spent = 0;
+    if (beginLeaf(check, L1, control) == SEARCH_RUNNING) stepLeaf(check, SIZE_MAX, &spent);
+    return endLeaf(check);
+}
+
+bool partialLeafPossible(LeafCheck *check, const size_t *span, const size_t *generated, size_t k) {
+    if (check->reverse) return deriveOuterPermutation(check, span, generated, k);
+    size_t n = check->n;
+    size_t words = check->words;
+    size_t *G = check->G->elements;
+    memset(check->tSets, 0, sizeof(uint64_t) * n * words);
+    for (size_t i = 0; i < n; ++i) {
+        check->targets[i] = SIZE_MAX;
+    }
+
+    // Every x of the span is L1^{-1}(w) for w = L1(x), so x is in the known part of the t-set of G' at b_i if w is a t
+    for (size_t c = 0; c < 1L << k; ++c) {
+        size_t x = span[c];
+        size_t w = generated[x];
+        for (size_t i = 0; i < n; ++i) {
+            if (check->tSetsG[i * words + w / 64] >> (w % 64) & 1) {
+                check->tSets[i * words + x / 64] |= 1ULL << (x % 64);
             }
-            destroyTruthTable(newG);
+            if (w == G[check->basis[i]]) check->targets[i] = x; // G'(b_i) = x
         }
-    } else {
-        result = dfs(restrictedDomains, 0, values, F, G, L2, basis);
-        if (result) {
-            /* If everything went smoothly, we should have aPrime == G */
-            TruthTable *aPrime = compose(F, L2);
+    }
 
-            destroyTruthTable(aPrime);
+    /* The image of b_i under L2 must have a t-set of F containing the known part, and in a linear search it must also
+     * be a pre-image of G'(b_i) under F once that value is known */
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t *known = check->tSets + i * words;
+        size_t target = check->affineSearch ? SIZE_MAX : check->targets[i];
+        size_t first = target == SIZE_MAX ? 0 : check->preimageOffsets[target];
+        size_t last = target == SIZE_MAX ? 1L << n : check->preimageOffsets[target + 1];
+        bool possible = false;
+        for (size_t j = first; j < last && !possible; ++j) {
+            size_t x = target == SIZE_MAX ? j : check->preimages[j];
+            possible = subsetOf(known, check->tSetsF + x * words, words);
         }
+        if (!possible) return false;
     }
+    return true;
+}
 
-    free(values);
+void destroyLeafCheck(LeafCheck *check) {
+    TruthTable *derived = endLeaf(check);
+    if (derived != NULL) destroyTruthTable(derived);
+    free(check->tSetsG);
+    free(check->tSets);
+    free(check->tSetsF);
+    free(check->targets);
+    free(check->restricted);
+    free(check->restrictedSizes);
+    free(check->preimageOffsets);
+    free(check->preimages);
+    if (check->outer != NULL) destroyPartialLinearMap(check->outer);
+    free(check);
+}
 
-    for (size_t i = 0; i < dimension; ++i) {
-        destroyNodes(restrictedDomains[i]);
+/**
+ * Remove the values of the unassigned basis elements that are inconsistent with the points of L2 from index first on:
+ * if x is such a point, then the value v of basis element b must satisfy F(L2(x) + v) = G(x + b).
+ * @return False if a domain became empty
+ */
+static bool forwardCheck(InnerSearch *search, size_t first, size_t depth) {
+    PartialLinearMap *L2 = search->L2;
+    size_t *F = search->F->elements;
+    size_t *G = search->G->elements;
+    for (size_t i = 0; i < search->n; ++i) {
+        if (search->assigned[i]) continue;
+        size_t b = search->basis[i];
+        for (size_t j = 0; j < search->domainSizes[i]; ++j) {
+            if (search->removedAt[i][j] != SIZE_MAX) continue;
+            size_t v = search->domains[i][j];
+            for (size_t p = first; p < L2->count; ++p) {
+                size_t x = L2->points[p];
+                if (F[L2->values[x] ^ v] != G[x ^ b ^ search->offset]) {
+                    search->removedAt[i][j] = depth;
+                    search->alive[i] -= 1;
+                    break;
+                }
+            }
+        }
+        if (search->alive[i] == 0) return false;
     }
-    free(restrictedDomains);
-    return result;
+    return true;
 }
 
-bool dfs(Node **domains, size_t k, size_t *values, TruthTable *F, TruthTable *G, TruthTable *L2, const size_t *basis) {
-    size_t dimension = F->n;
-    if (k == dimension) return true;
-
-    Node *current = domains[k]->next;
-    while (current != NULL) {
-        /* Guess that basis element #k maps to current->data */
-        values[k] = current->data;
-        /* Fill up part of the truth table (on the span of the guessed elements) */
-        _Bool problem = false;
-        for (size_t linear_combination = 0; linear_combination < (1L << k); ++linear_combination) {
-            /* We are using the standard basis, and therefore the linear combination is the same
-             * as the vector describing it
-             */
-            size_t new_input = linear_combination ^ (1L << k);
-            size_t new_value = L2->elements[linear_combination] ^ current->data;
-            L2->elements[new_input] = new_value;
-            /* Check for a violation of F * L2 = G */
-            if (F->elements[new_value] != G->elements[new_input]) {
-                /* Something is wrong, backtrack */
-                problem = true;
-                break;
+/**
+ * Put back the values that were removed by the forward check at the given depth
+ */
+static void restoreDomains(InnerSearch *search, size_t depth) {
+    for (size_t i = 0; i < search->n; ++i) {
+        if (search->assigned[i]) continue;
+        for (size_t j = 0; j < search->domainSizes[i]; ++j) {
+            if (search->removedAt[i][j] == depth) {
+                search->removedAt[i][j] = SIZE_MAX;
+                search->alive[i] += 1;
             }
         }
-        if (!problem) {
-            if (dfs(domains, k + 1, values, F, G, L2, basis)) return true;
+    }
+}
+
+SearchStatus dfs(InnerSearch *search, size_t budget) {
+    size_t dimension = search->n;
+    PartialLinearMap *L2 = search->L2;
+    size_t expanded = 0;
+    while (true) {
+        size_t depth = search->depth;
+        if (search->entering) {
+            if (depth == dimension) return SEARCH_FOUND;
+            if (expanded == budget) return SEARCH_RUNNING;
+            expanded += 1;
+            search->nodes += 1;
+            search->entering = false;
+            // A smaller constant c2 of the same sweep already succeeded
+            if (search->firstFound != NULL &&
+                __atomic_load_n(search->firstFound, __ATOMIC_ACQUIRE) < search->candidate) {
+                return SEARCH_EXHAUSTED;
+            }
+            // The time budget and the signals also apply within a leaf, which can take long at large dimensions
+            if (search->control != NULL && searchStopRequested(search->control)) return SEARCH_EXHAUSTED;
+
+            // Guess the basis element with the fewest values left
+            size_t k = dimension;
+            for (size_t i = 0; i < dimension; ++i) {
+                if (!search->assigned[i] && (k == dimension || search->alive[i] < search->alive[k])) k = i;
+            }
+            search->assigned[k] = true;
+            search->order[depth] = k;
+            search->next[depth] = 0;
+            search->counts[depth] = L2->count;
+        }
+
+        size_t k = search->order[depth];
+        size_t count = search->counts[depth];
+        bool descended = false;
+        while (!descended && search->next[depth] < search->domainSizes[k]) {
+            size_t j = search->next[depth]++;
+            if (search->removedAt[k][j] != SIZE_MAX) continue;
+            size_t value = search->domains[k][j];
+            /* Guess that basis element #k maps to value, and fill up the truth table on the span of the guessed
+             * elements. The forward check has already made F * L2 = G hold on the new points, so only the
+             * bijectivity of L2 remains to be checked. */
+            if (addPoint(L2, search->basis[k], value) && forwardCheck(search, count, depth)) {
+                search->depth = depth + 1;
+                search->entering = true;
+                descended = true;
+            } else {
+                restoreDomains(search, depth);
+                resetPoints(L2, count);
+            }
         }
-        current = current->next;
+        if (descended) continue;
+
+        // No value is left for the basis element, so the guess of the parent is undone
+        search->assigned[k] = false;
+        if (depth == 0) return SEARCH_EXHAUSTED;
+        search->depth = depth - 1;
+        restoreDomains(search, depth - 1);
+        resetPoints(L2, search->counts[depth - 1]);
     }
-    return false;
 }
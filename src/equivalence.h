@@ -1,6 +1,11 @@
 #ifndef AFFINE_EQUIVALENCE_H
 #define AFFINE_EQUIVALENCE_H
 
+#include <stdint.h>
+#include "structures.h"
+#include "control.h"
+#include "permutation.h"
+
 /**
  * Parse file containing the elements of a truth table. The first line is the n of the truth table. The
  * second line contains all the elements of the truth table:
@@ -12,11 +17,26 @@
  */
 TruthTable *parseFile(char *file);
 
+/**
+ * The largest size of the message that readFile gives when a file cannot be parsed
+ */
+#define READ_ERROR_SIZE 256
+
+/**
+ * Parse a file like parseFile, but report a file that cannot be parsed to the caller instead of exiting, so that the
+ * file can be read on another thread than the one that reports the error.
+ * @param file The file path of the truth table
+ * @param error Receives the reason the file cannot be parsed, at most READ_ERROR_SIZE characters
+ * @return The parsed truth table, or NULL if the file cannot be parsed
+ */
+TruthTable *readFile(char *file, char *error);
+
 /**
  * Map two partitions F and G with respect to their pre-images.
  * @param F Partition of a function F
  * @param G Partition of a function G
- * @return A list where the pre-image of F -> G.
+ * @return A list where the pre-image of F -> G, or NULL if the buckets of F and G do not have the same multiplicities
+ * and sizes.
  */
 size_t *mapPreImages(Partition *F, Partition *G);
 
@@ -34,54 +54,257 @@ void countElements(TruthTable *F, size_t *occurrences);
  * @param n Dimension
  * @param basis A basis = {b_1, ..., b_n}
  * @param map Tells how F -> G
+ * @param orbit The orbit of b_1 under the automorphisms of functionF, used to skip symmetric branches; NULL if the
+ * symmetries should not be broken
+ * @param control Time budget, cancellation and checkpoints of the search
  * @return All linear permutations L1
  */
 bool outerPermutation(Partition *F, Partition *G, size_t n, size_t *basis, size_t *map, TruthTable *functionF,
-                      TruthTable *functionG, bool affineSearch);
+                      TruthTable *functionG, bool affineSearch, const bool *orbit, SearchControl *control);
 
 /**
- * Recursive function for reconstruction of all linear permutations L1
- * @param k Recursive step
- * @param basis A basis {b_1,...,b_n}
- * @param images Images of the basis elements under L
- * @param partitionF Partition of function F
- * @param partitionG Partition of function G
+ * Reconstruct a linear inner permutation L2 first, and derive L1 from it. The same tree walk as for L1 guesses the
+ * images of a basis of the inputs of G under L2 over the input partitions: G(x) = L1(F(L2(x))), so x and L2(x) have
+ * the same t-set size and the same number of pre-images of their value. Each node checks that the pairs
+ * F(L2(x)) -> G(x) of the span still fit a linear permutation L1.
+ * @param G Input partition of function G, whose basis is guessed
+ * @param F Input partition of function F
  * @param n Dimension
- * @param generated A partial truth table for L
- * @param generatedImages List, same size as images, holds the information if the images has been generated or not
- * @param L1 List that should hold all the linear permutations L1
- * @param fBucket Map of the buckets of function F
- * @param gBucket Map of the buckets of function G
+ * @param basis A basis {b_1, ..., b_n} of the inputs of G
+ * @param map Tells how G -> F
+ * @param functionF The function F
+ * @param functionG The function G
+ * @param control Time budget, cancellation and checkpoints of the search
+ * @return True if L1 and L2 were found
+ */
+bool innerPermutationFirst(Partition *G, Partition *F, size_t n, size_t *basis, size_t *map, TruthTable *functionF,
+                           TruthTable *functionG, SearchControl *control);
+
+/**
+ * What the leaves of the search for L1 under one constant c1 share. A leaf checks for L2 with F * L2 = G', where
+ * G' = L1^{-1} * G, and the t-set of G' at x is the image of the t-set of G at x under L1^{-1}, since L1^{-1} is
+ * linear. So the t-sets of G at the basis elements are computed once, and each leaf only relabels them; G' itself is
+ * only built once the restricted domains show that the inner search is needed.
+ */
+typedef struct LeafCheck {
+    size_t n; // Dimension
+    TruthTable *F; // The function F
+    TruthTable *G; // The function G
+    const size_t *basis; // A basis {b_1, ..., b_n}
+    bool affineSearch; // True if L2 may have a constant term c2
+    size_t words; // Number of words of a bitset of 2^n bits
+    uint64_t *tSetsG; // Bitset i holds the t-set of G at b_i
+    uint64_t *tSets; // The t-sets of G' at the basis elements, relabeled at each leaf
+    uint64_t *tSetsF; // Bitset x holds the t-set of F at x, kept for the lookahead only, NULL otherwise
+    size_t *targets; // Work space of the lookahead: the known values of G' at the basis elements
+    size_t *restricted; // The restricted domain of b_i starts at restricted[i * 2^n]
+    size_t *restrictedSizes; // The number of elements in each restricted domain
+    size_t *preimageOffsets; // The pre-images of y under F start at preimages[preimageOffsets[y]]
+    size_t *preimages; // The pre-images of all the values of F
+    bool reverse; // True if the leaves are inner permutations, from which the outer permutation is derived
+    PartialLinearMap *outer; // The outer permutation derived from a partial inner permutation, if reverse
+    struct OffsetSweep *sweep; // The search for L2 of the leaf being checked, NULL between leaves
+    TruthTable *derived; // The permutation derived at the leaf being checked, once it is found
+} LeafCheck;
+
+/**
+ * Initialize the check of the leaves of one constant, computing the t-sets of G and the pre-images of F
+ * @param F The function F
+ * @param G The function G
+ * @param basis A basis {b_1, ..., b_n}
+ * @param affineSearch True if L2 may have a constant term c2
+ * @param lookahead True if partial outer permutations will be checked, which needs the t-sets of F at every x
+ * @return A new LeafCheck
+ */
+LeafCheck *initLeafCheck(TruthTable *F, TruthTable *G, const size_t *basis, bool affineSearch, bool lookahead);
+
+/**
+ * Initialize the check of the leaves of a search that guesses the inner permutation L2 first. A leaf is a complete
+ * L2, and L1 is the linear permutation with L1(F(L2(x))) = G(x), if there is one.
+ * @param F The function F
+ * @param G The function G
+ * @return A new LeafCheck in reverse
+ */
+LeafCheck *initReverseLeafCheck(TruthTable *F, TruthTable *G);
+
+/**
+ * Check whether a partial outer permutation can still lead to a leaf with an inner permutation. L1 is known on the
+ * span V of the first k basis elements, so L1^{-1} is known on L1(V), and the t-set of G' at b_i contains L1^{-1} of
+ * the t's of G at b_i that lie in L1(V). If no x has a t-set of F containing that part, the restricted domain of b_i
+ * is empty at every leaf below, and so is the domain when the known value of G'(b_i) has no pre-image among them.
+ * In reverse, the partial permutation is L2, and the pairs F(L2(x)) -> G(x) of the span must fit a linear permutation.
+ * @param check The leaf check of the constant, initialized with the lookahead or in reverse
+ * @param span The elements of the span of the basis
+ * @param generated The partial truth table of L1, or of L2 in reverse
+ * @param k Number of basis elements whose image is known
+ * @return False if no leaf below can have an inner permutation
+ */
+bool partialLeafPossible(LeafCheck *check, const size_t *span, const size_t *generated, size_t k);
+
+/**
+ * Begin the check of a complete outer permutation L1: relabel the t-sets, restrict the domains and, if every basis
+ * element has a possible image, set up the search for L2 with F * L2 = G', which stepLeaf then runs. A leaf in reverse
+ * is decided right away.
+ * @param check The leaf check of the constant, with no leaf being checked
+ * @param L1 The outer permutation, or the inner permutation in reverse
+ * @param control The budget and signals that cut the check short, and the owner of the pool of threads the constants
+ * c2 are searched on; NULL to search on one thread until the end
+ * @return SEARCH_RUNNING if the search for L2 has to be stepped, otherwise SEARCH_FOUND or SEARCH_EXHAUSTED
+ */
+SearchStatus beginLeaf(LeafCheck *check, TruthTable *L1, SearchControl *control);
+
+/**
+ * Expand the nodes of the search for L2 of the leaf being checked, a round at a time: with several threads, each
+ * thread expands its share of the budget on the constants c2 it holds, and the round ends once all of them are done.
+ * @param check The leaf check, whose leaf was begun with SEARCH_RUNNING
+ * @param budget The number of nodes to expand at most, SIZE_MAX to search until the end
+ * @param spent The number of nodes expanded, added to
+ * @return SEARCH_RUNNING if the budget was spent first, SEARCH_FOUND, or SEARCH_EXHAUSTED if there is no L2 or if the
+ * check was cut short
+ */
+SearchStatus stepLeaf(LeafCheck *check, size_t budget, size_t *spent);
+
+/**
+ * End the check of a leaf, whether it was decided or not
+ * @param check The leaf check
+ * @return A new truth table of L2, or of L1 in reverse, or NULL if none was found
+ */
+TruthTable *endLeaf(LeafCheck *check);
+
+/**
+ * Check a complete outer permutation L1 until the end: it is a solution if there is an L2 with L1 * F * L2 = G, i.e.
+ * F * L2 = G'. In reverse, the permutation is L2, and the solution is the L1 derived from it.
+ * @param check The leaf check of the constant
+ * @param L1 The outer permutation, or the inner permutation in reverse
+ * @param control The budget and signals that cut the check short, and the owner of the pool of threads the constants
+ * c2 are searched on; NULL to search on one thread until the end
+ * @return A new truth table of L2, or of L1 in reverse, or NULL if there is none or if the check was cut short
+ */
+TruthTable *checkLeaf(LeafCheck *check, TruthTable *L1, SearchControl *control);
+
+/**
+ * Free the memory allocated for the leaf check
+ * @param check The leaf check to destroy
+ */
+void destroyLeafCheck(LeafCheck *check);
+
+/**
+ * Stop the threads of a pool that searched the constants c2 of the leaves of a search, and free their state
+ * @param pool The pool of a search control, may be NULL
+ */
+void destroySweepPool(SweepPool *pool);
+
+/**
+ * The search for L1 as a walk of a tree with an explicit stack, so that it can be run a slice at a time and inspected
+ * in between. The node at depth k has guessed the images of the first k basis elements, and its children are the
+ * images of b_k in the matching bucket of G that agree with the buckets of the whole span by linearity. At a leaf, the
+ * complete L1 is checked for an inner permutation. The frontier is also recorded in the search control, so that a
+ * checkpoint written while walking resumes at the node being expanded.
+ */
+typedef struct TreeWalk {
+    size_t n; // Dimension
+    Partition *F; // Partition of function F, the basis elements are taken from its domain
+    Partition *G; // Partition of function G, the images are guessed from its buckets
+    const size_t *basis; // A basis {b_1, ..., b_n}
+    size_t *span; // The elements of the span of the basis, element number c being the sum of the b_i with bit i in c
+    size_t *map; // Tells how F -> G
+    LeafCheck *leaves; // The check for an inner permutation at the leaves
+    const bool *orbit; // The orbit of b_1 under the automorphisms of function F, or NULL
+    SearchControl *control; // Time budget, cancellation and checkpoints of the search
+    size_t *generated; // A partial truth table for L1, known on the span of the basis elements of the path
+    bool *generatedImages; // generatedImages[y] is true if y is the image of some element of the span
+    size_t *occupancy; // The number of generated images in each bucket of G
+    size_t depth; // Depth of the node on top of the stack, i.e. the number of basis elements with an image
+    bool entering; // True if the node on top of the stack has not been expanded yet
+    size_t *next; // next[k] is the position in the bucket of G of the next image to try for b_k
+    size_t *filled; // filled[k] is the number of values derived from the image of b_k on the path
+    TruthTable *guessed; // The permutation of the leaf on top of the stack while it is checked, NULL otherwise
+    size_t nodes; // Number of nodes expanded so far, those of the searches for L2 at the leaves included
+    SearchStatus status; // SEARCH_RUNNING until the walk is over, then how it ended
+} TreeWalk;
+
+/**
+ * Initialize a walk of the tree of all linear permutations L1 that respect the partitions induced by F and G
+ * @param F Partition of function F
+ * @param G Partition of function G
+ * @param n Dimension
+ * @param basis A basis {b_1, ..., b_n}
  * @param map Tells how F -> G
+ * @param leaves The check for an inner permutation at the leaves
+ * @param orbit The orbit of b_1 under the automorphisms of function F, or NULL
+ * @param control Time budget, cancellation and checkpoints of the search; also records the frontier of the search
+ * @return A new walk, standing at the root
  */
-void
-guessValuesOfL(size_t k, size_t *basis, size_t *images, Partition *partitionF, Partition *partitionG, size_t n,
-               size_t *generated, bool *generatedImages, size_t *fBucket, size_t *gBucket, size_t *map,
-               bool *foundSolution, TruthTable *functionF, TruthTable *functionG, bool affineSearch);
+TreeWalk *initTreeWalk(Partition *F, Partition *G, size_t n, const size_t *basis, size_t *map, LeafCheck *leaves,
+                       const bool *orbit, SearchControl *control);
 
 /**
- * Create a list that tells in which bucket each element belongs to.
- * @param F Partition of a function F
+ * Expand the nodes of the walk in depth first order until the budget is spent or the walk is over. The nodes of the
+ * search for an inner permutation at a leaf count towards the budget too, and a leaf whose check is not over when the
+ * budget is spent is checked further by the next call. When an equivalence is found, it is printed and recorded in
+ * the search control.
+ * @param walk The walk
+ * @param budget The number of nodes to expand at most, SIZE_MAX to walk until the end
+ * @return SEARCH_RUNNING if the budget was spent first, SEARCH_FOUND, SEARCH_EXHAUSTED once the whole tree has been
+ * walked, or the status of the search control if it stopped the walk
+ */
+SearchStatus guessValuesOfL(TreeWalk *walk, size_t budget);
+
+/**
+ * Free the memory allocated for the walk, which does not own the partitions, the basis or the leaf check
+ * @param walk The walk to destroy
+ */
+void destroyTreeWalk(TreeWalk *walk);
+
+/**
+ * Estimate the size of the search tree of guessValuesOfL without searching it, with Knuth's method: each probe walks
+ * down one random path of the tree, and the product of the numbers of children along the path estimates the number
+ * of nodes at each depth. The time spent in the nodes of the path, weighted the same way, estimates the run time.
+ * @param F Partition of function F
+ * @param G Partition of function G
  * @param n Dimension
- * @return A list holding the information of which bucket each element belongs to.
+ * @param basis A basis {b_1,...,b_n}
+ * @param map Tells how F -> G
+ * @param functionF The function F
+ * @param functionG The function G
+ * @param affineSearch True if the search is for affine equivalence
+ * @param reverse True if the tree is the one of innerPermutationFirst, over the input partitions of G and F
+ * @param orbit The orbit of b_1 under the automorphisms of functionF, or NULL
+ * @param lookahead Number of depths above the leaves where partial outer permutations are checked
+ * @param probes Number of random paths to walk down
+ * @param estimate The estimate, to which the averages over the probes are added
  */
-size_t *createBucketRepresentation(Partition *F, size_t n);
+void estimateSearchTree(Partition *F, Partition *G, size_t n, size_t *basis, size_t *map, TruthTable *functionF,
+                        TruthTable *functionG, bool affineSearch, bool reverse, const bool *orbit, size_t lookahead,
+                        size_t probes, TreeEstimate *estimate);
 
 /**
  * Compute the set of t's where t = F[x] + F[y] + F[x + y]
  * @param F Function containing the elements to compute the t's over
  * @param x A fixed value to compute with
- * @return A set of the T's from the computation
+ * @param tSet The set of the t's, as a bitset of 2^n bits
  */
-bool *computeSetOfTs(TruthTable *F, size_t x);
+void computeSetOfTs(TruthTable *F, size_t x, uint64_t *tSet);
 
 /**
- * Compute the restricted domain for the given list of T's
+ * Partition the inputs of a function by the size of their set of T's and the number of pre-images of their value.
+ * Both are kept by linear equivalence, G = L1 * F * L2 maps the t-set of F at L2(x) to the t-set of G at x, and they
+ * are also kept by adding a constant to G, which only translates the t-sets. This takes 4^n steps.
+ * @param F The function F
+ * @return A new Partition of the inputs of F, matched to others by mapPreImages
+ */
+Partition *partitionInputs(TruthTable *F);
+
+/**
+ * Compute the restricted domains for the given sets of T's. An element x is in the restricted domain of T if every t
+ * of T is F[x] + F[y] + F[x + y] for some y, i.e. if T is a subset of the set of T's of F at x.
  * @param F Function F
- * @param map A set of T's that we want to compute the restricted domain over
- * @return The restricted domain represented as a linked list
+ * @param tSets The sets of T's, as bitsets of 2^n bits one after the other
+ * @param count Number of sets of T's
+ * @param domains The restricted domain of set i is stored from domains[i * 2^n] on, from the largest element down
+ * @param sizes The number of elements in each restricted domain
  */
-Node *computeRestrictedDomains(TruthTable *F, const bool *map);
+void computeRestrictedDomains(TruthTable *F, const uint64_t *tSets, size_t count, size_t *domains, size_t *sizes);
 
 /**
  * Reconstruction of the inner permutation L2
@@ -89,22 +312,55 @@ Node *computeRestrictedDomains(TruthTable *F, const bool *map);
  * @param G The truth table of function G
  * @param basis A basis {b_1, ..., b_n}
  * @param L2 The inner permutation
+ * @param affineSearch True if L2 may have a constant term c2, which is then guessed among the pre-images of G(0)
  * @return Returns True if reconstruction of L2 was successful, False otherwise
  */
 bool innerPermutation(TruthTable *F, TruthTable *G, const size_t *basis, TruthTable *L2, bool affineSearch);
 
 /**
- * A dept first search to reconstruct the inner permutation L2.
- * @param domains The restricted domains over the list of T's computed previously
- * @param k The recursive step
- * @param values Initially a empty list, in use for guessing basis elements that maps to elements
- * @param F The truth table of a function F
- * @param G The truth table of a function G
- * @param L2 The inner permutation
- * @param basis A basis {b_1,...,b_n}
- * @return
+ * The state of the search for the inner permutation L2 with F * L2 = G. Every basis element has a domain of possible
+ * images; a value that is removed from a domain records the depth that removed it, so that it can be put back when
+ * the search backtracks.
+ */
+typedef struct InnerSearch {
+    size_t n; // Dimension
+    TruthTable *F; // The function F
+    TruthTable *G; // The function G
+    size_t offset; // G is read as G(x + offset), the constant c2 of an affine inner permutation
+    const size_t *basis; // A basis {b_1, ..., b_n}
+    size_t *preimageOffsets; // The pre-images of y under F start at preimages[preimageOffsets[y]]
+    size_t *preimages; // The pre-images of all the values of F
+    size_t **domains; // domains[i] holds the possible images of b_i
+    size_t *capacities; // Number of values domains[i] and removedAt[i] have room for, grown as leaves need it
+    size_t *domainSizes; // The number of values in each domain
+    size_t **removedAt; // removedAt[i][j] is the depth that removed domains[i][j], SIZE_MAX if it is still possible
+    size_t *alive; // The number of values left in each domain
+    bool *assigned; // assigned[i] is true if the image of b_i has been guessed
+    bool *marks; // Work space of 2^n entries, all false between uses
+    PartialLinearMap *L2; // The partial inner permutation
+    size_t candidate; // Index of the constant c2 among the constants searched
+    const size_t *firstFound; // Smallest constant known to succeed, read atomically; NULL for a single search
+    SearchControl *control; // Polled at every node, NULL if the search cannot be stopped
+    size_t depth; // The number of basis elements guessed on the path to the node on top of the stack
+    bool entering; // True if the node on top of the stack has not been expanded yet
+    size_t *order; // order[d] is the basis element guessed at depth d
+    size_t *next; // next[d] is the position in the domain of the next value to try at depth d
+    size_t *counts; // counts[d] is the number of points of L2 before the guess at depth d
+    bool active; // True while the search of the constant c2 is not over
+    size_t nodes; // Number of nodes expanded so far, over all the searches of this state
+} InnerSearch;
+
+/**
+ * A depth first search to reconstruct the inner permutation L2, with an explicit stack so that it can be run a slice
+ * at a time. At each depth we guess the image of the basis element with the fewest possible values left, extend L2 by
+ * linearity, and remove the values of the other basis elements that no longer agree with G; we backtrack as soon as a
+ * domain is empty. The search starts at the root set up by its domains.
+ * @param search The state of the search
+ * @param budget The number of nodes to expand at most, SIZE_MAX to search until the end
+ * @return SEARCH_RUNNING if the budget was spent first, SEARCH_FOUND if L2 was found, in which case it is left in
+ * search->L2, or SEARCH_EXHAUSTED if there is none or if the search was asked to stop
  */
-bool dfs(Node **domains, size_t k, size_t *values, TruthTable *F, TruthTable *G, TruthTable *L2, const size_t *basis);
+SearchStatus dfs(InnerSearch *search, size_t budget);
 
 /**
  * Check if a function F is affine
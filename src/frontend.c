@@ -0,0 +1,77 @@
+#include <time.h>
+#include "structures.h"
+#include "equivalence.h"
+#include "control.h"
+#include "dispatch.h"
+
+/**
+ * Print out a list over all the flags that can be used in the program
+ */
+void printFrontendHelp();
+
+int main(int argc, char *argv[]) {
+    RunTimes *runTime;
+    clock_t startTotalTime;
+    SearchControl *control = initSearchControl(); // Time budget, cancellation and checkpoints
+    QueryArguments arguments;
+    arguments.type = EA_EQUIVALENCE;
+    int exitStatus;
+    if (!parseQueryArguments(argc, argv, control, &arguments, true, printFrontendHelp, &exitStatus)) {
+        destroySearchControl(control);
+        return exitStatus;
+    }
+    startTotalTime = clock();
+    runTime = initRunTimes();
+
+    if (arguments.functionG == NULL) {
+        // Create a random function G with respect to F
+        switch (arguments.type) {
+            case LINEAR_EQUIVALENCE:
+                arguments.functionG = createLinearFunction(arguments.functionF);
+                break;
+            case AFFINE_EQUIVALENCE:
+                arguments.functionG = createAffineEquivalentFunction(arguments.functionF);
+                break;
+            case EA_EQUIVALENCE:
+                arguments.functionG = createAffineTruthTable(arguments.functionF);
+                break;
+        }
+        printf("G:\n");
+        printTruthTable(arguments.functionG);
+    }
+    PreparedFunction *preparedF;
+    PreparedFunction *preparedG;
+    startQuery(control, "equivalence", &arguments, &preparedF, &preparedG);
+
+    bool foundSolution = dispatchQuery(preparedF, preparedG, arguments.type, control);
+    if (!foundSolution && control->status == SEARCH_RUNNING) {
+        printf("Not equivalent\n");
+    }
+    SearchStatus status = finishSearchControl(control, foundSolution);
+
+    destroyPreparedFunction(preparedF);
+    destroyPreparedFunction(preparedG);
+    runTime->total = stopTime(runTime->total, startTotalTime);
+    if (arguments.times) {
+        printTimes(runTime);
+    }
+    destroyRunTimes(runTime);
+    destroySearchControl(control);
+    return status;
+}
+
+void printFrontendHelp() {
+    printf("Equivalence test\n");
+    printf("Check for equivalence between two functions F and G, using the fastest engine that applies.\n");
+    printf("Usage: equivalence [equivalence_options] [filenameF] [filenameG] \n");
+    printf("Equivalence_options:\n");
+    printf("\t-h \t- Print help\n");
+    printf("\t-t \t- Print run time\n");
+    printf("\t-e \t- Test for EA-equivalence (default)\n");
+    printf("\t-a \t- Test for affine equivalence\n");
+    printf("\t-l \t- Test for linear equivalence\n");
+    printControlHelp();
+    printf("\n");
+    printf("\tfilenameF = the path to file of function F\n");
+    printf("\tfilenameG = the path to file of function G\n");
+}
@@ -1,43 +1,60 @@
 #include "orthoderivative.h"
+#include "bitslice.h"
+#include "adjoint.h"
 
 /**
  * @author Nikolay S. Kaleyski
  */
 
-#define POPCOUNT_FUNCTION __builtin_popcountl
-
-TruthTable *orthoderivative(TruthTable *F) {
-    size_t dimension = F->n;
-    size_t entries = 1L << dimension;
-    TruthTable *od = initTruthTable(dimension);
-
-    /* Compute each element of the orthoderivative manually: o(a) must be such that
-     * the dot product o(a) * (F(x) + F(a+x) + F(a) + F(0)) is equal to 0 for all x. */
-    od->elements[0] = 0;
-    _Bool problem = false;
-    size_t count = 0;
-
-    for (size_t a = 1; a < entries; ++a) {
-        for (size_t possible_value = 1; possible_value < entries; ++possible_value) {
-            problem = false;
-            for (size_t x = 0; x < entries; ++x) {
-                size_t derivative = F->elements[0] ^ F->elements[a] ^ F->elements[x] ^ F->elements[x ^ a];
-                if (POPCOUNT_FUNCTION(possible_value & derivative) % 2) {
-                    problem = true;
-                    break;
-                }
-            }
-            if (!problem) {
-                od->elements[a] = possible_value;
-                count +=1 ;
-                break;
-            }
+bool orthoderivativeRange(TruthTable *F, BitSlicedTruthTable *sliced, size_t first, size_t last, TruthTable *od,
+                          SearchControl *control) {
+    /* Compute each element of the orthoderivative: o(a) must be such that the dot product
+     * o(a) * (F(x) + F(a+x) + F(a) + F(0)) is equal to 0 for all x. On the coordinates of F this is a linear system,
+     * and we take its smallest nonzero solution. */
+    for (size_t a = first; a < last; ++a) {
+        if (control != NULL && searchStopRequested(control)) return false;
+        if (a == 0) {
+            od->elements[0] = 0;
+            continue;
         }
+        od->elements[a] = smallestOrthogonalValue(sliced, a, F->elements[a] ^ F->elements[0]);
+        if (od->elements[a] == 0) {
+            /* No value is orthogonal to the derivative in direction a; we can stop right away */
+            return false;
+        }
+    }
+    return true;
+}
+
+TruthTable *findOrthoderivative(TruthTable *F) {
+    TruthTable *od = initTruthTable(F->n);
+    BitSlicedTruthTable *sliced = bitSlice(F);
+    bool exists = orthoderivativeRange(F, sliced, 0, 1L << F->n, od, NULL);
+    destroyBitSlicedTruthTable(sliced);
+    if (!exists) {
+        destroyTruthTable(od);
+        return NULL;
     }
-    if (count < entries - 1) {
+    return od;
+}
+
+TruthTable *orthoderivative(TruthTable *F) {
+    TruthTable *od = findOrthoderivative(F);
+    if (od == NULL) {
         printf("Orhtoderivative not working for one of the functions:\n");
         printTruthTable(F);
         exit(0);
     }
     return od;
 }
+
+bool eaCertificate(TruthTable *F, TruthTable *G, TruthTable *L1, TruthTable *L2, TruthTable **A1, TruthTable **A) {
+    TruthTable *L1Inverse = inverse(L1);
+    *A1 = adjoint(L1Inverse); // A1 = (L1^{-1})^*
+    TruthTable *FA2 = compose(F, L2); // F * A2
+    *A = compose(*A1, FA2); // A1 * F * A2
+    add(*A, G); // A = G + A1 * F * A2
+    destroyTruthTable(L1Inverse);
+    destroyTruthTable(FA2);
+    return algebraicDegree(*A) <= 1;
+}
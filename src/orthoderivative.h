@@ -1,12 +1,53 @@
 #ifndef AFFINE_ORTHODERIVATIVE_H
 #define AFFINE_ORTHODERIVATIVE_H
 #include "structures.h"
+#include "bitslice.h"
+#include "control.h"
 
 /**
- * Create the orthoderivative of the function F.
+ * Create the orthoderivative of the function F, if it exists. The orthoderivative only exists for quadratic APN
+ * functions.
+ * @param F The function F
+ * @return The orthoderivative of F, or NULL if F has no orthoderivative
+ */
+TruthTable *findOrthoderivative(TruthTable *F);
+
+/**
+ * Compute the elements of the orthoderivative of F in the directions a from first up to, but not including, last. The
+ * directions are independent, so that ranges of them can be computed on separate threads.
+ * @param F The function F
+ * @param sliced The bit-sliced truth table of F
+ * @param first The first direction
+ * @param last The direction after the last one
+ * @param od The truth table receiving the elements of the orthoderivative
+ * @param control Polled before each direction, so that the range stops when the search is asked to; NULL if it cannot
+ * be stopped
+ * @return False if some direction has no orthogonal value, i.e. if F has no orthoderivative, or if the range was
+ * stopped; a stop request stays pending, so searchStopRequested tells the two apart
+ */
+bool orthoderivativeRange(TruthTable *F, BitSlicedTruthTable *sliced, size_t first, size_t last, TruthTable *od,
+                          SearchControl *control);
+
+/**
+ * Create the orthoderivative of the function F. The program exits if F has no orthoderivative.
  * @param F The function F
  * @return The orthoderivative of F
  */
 TruthTable *orthoderivative(TruthTable *F);
 
+/**
+ * Derive an EA-equivalence G = A1 * F * A2 + A of quadratic APN functions from a linear equivalence
+ * L1 * orthoderivative(F) * L2 = orthoderivative(G) of their orthoderivatives. If G = A1 * F * L2 + A, the
+ * orthoderivative of G is (A1^*)^{-1} * orthoderivative(F) * L2, so A2 = L2 and A1 is the adjoint of the inverse of L1.
+ * The affine part A = G + A1 * F * A2 then follows without any search.
+ * @param F The function F
+ * @param G The function G
+ * @param L1 The outer permutation of the orthoderivatives
+ * @param L2 The inner permutation of the orthoderivatives
+ * @param A1 Receives the outer permutation A1
+ * @param A Receives the affine function A
+ * @return True if A is affine, i.e. if (A1, L2, A) is an EA-equivalence
+ */
+bool eaCertificate(TruthTable *F, TruthTable *G, TruthTable *L1, TruthTable *L2, TruthTable **A1, TruthTable **A);
+
 #endif //AFFINE_ORTHODERIVATIVE_H
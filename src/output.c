@@ -0,0 +1,218 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "structures.h"
+#include "output.h"
+
+/**
+ * The size of the buffer of a results file
+ */
+#define SINK_BUFFER_SIZE (1L << 20)
+
+/**
+ * The most bytes a number takes in any format, with its separator
+ */
+#define NUMBER_BYTES 21
+
+/**
+ * The most bytes a result takes besides its name and its numbers
+ */
+#define RESULT_OVERHEAD 64
+
+static ResultFormat sinkFormat = RESULTS_TEXT; // The format of the results
+static FILE *sinkFile = NULL; // The file of the results, NULL while they go to standard output
+
+/**
+ * The buffer that a thread formats its results into, kept from one result to the next and grown to the largest one
+ */
+typedef struct ThreadBuffer {
+    char *bytes; // The buffer
+    size_t capacity; // Number of bytes the buffer has room for
+} ThreadBuffer;
+
+static pthread_key_t bufferKey; // The buffer of each thread
+static pthread_once_t bufferKeyCreated = PTHREAD_ONCE_INIT;
+
+static void destroyThreadBuffer(void *argument) {
+    ThreadBuffer *buffer = argument;
+    free(buffer->bytes);
+    free(buffer);
+}
+
+static void createBufferKey(void) {
+    pthread_key_create(&bufferKey, destroyThreadBuffer);
+}
+
+/**
+ * Find the buffer of the calling thread, with room for at least size bytes
+ */
+static char *threadBuffer(size_t size) {
+    pthread_once(&bufferKeyCreated, createBufferKey);
+    ThreadBuffer *buffer = pthread_getspecific(bufferKey);
+    if (buffer == NULL) {
+        buffer = calloc(1, sizeof(ThreadBuffer));
+        pthread_setspecific(bufferKey, buffer);
+    }
+    if (buffer->capacity < size) {
+        buffer->bytes = realloc(buffer->bytes, size);
+        buffer->capacity = size;
+    }
+    return buffer->bytes;
+}
+
+/**
+ * The stream the results are written to
+ */
+static FILE *sinkStream(void) {
+    return sinkFile != NULL ? sinkFile : stdout;
+}
+
+bool openResultSink(ResultFormat format, const char *file) {
+    sinkFormat = format;
+    if (file == NULL) return true;
+    sinkFile = fopen(file, format == RESULTS_BINARY ? "wb" : "w");
+    if (sinkFile == NULL) return false;
+    setvbuf(sinkFile, NULL, _IOFBF, SINK_BUFFER_SIZE);
+    if (format == RESULTS_BINARY) fwrite(RESULTS_MAGIC, 1, strlen(RESULTS_MAGIC), sinkFile);
+    return true;
+}
+
+/**
+ * A result being formatted into the buffer of the thread, which has room for all of it
+ */
+typedef struct ResultBuffer {
+    FILE *stream; // The stream to write to
+    char *bytes; // The buffer
+    size_t used; // Number of bytes in the buffer
+} ResultBuffer;
+
+static void appendBytes(ResultBuffer *buffer, const void *bytes, size_t count) {
+    memcpy(buffer->bytes + buffer->used, bytes, count);
+    buffer->used += count;
+}
+
+static void appendString(ResultBuffer *buffer, const char *string) {
+    appendBytes(buffer, string, strlen(string));
+}
+
+static void appendNumber(ResultBuffer *buffer, size_t value) {
+    buffer->used += formatNumber(value, buffer->bytes + buffer->used);
+}
+
+/**
+ * Append the lowest bytes of a value, least significant byte first
+ */
+static void appendLittleEndian(ResultBuffer *buffer, size_t value, size_t count) {
+    char *out = buffer->bytes + buffer->used;
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = (char) (value >> 8 * i & 0xFF);
+    }
+    buffer->used += count;
+}
+
+/**
+ * Start a binary record with its kind and name
+ */
+static void appendRecordHeader(ResultBuffer *buffer, char kind, const char *name) {
+    size_t length = strlen(name);
+    appendLittleEndian(buffer, (size_t) kind, 1);
+    appendLittleEndian(buffer, length, 1);
+    appendBytes(buffer, name, length);
+}
+
+/**
+ * Take the buffer of the thread for a result of at most size bytes
+ */
+static void beginResult(ResultBuffer *buffer, size_t size) {
+    buffer->stream = sinkStream();
+    buffer->bytes = threadBuffer(size);
+    buffer->used = 0;
+}
+
+/**
+ * Write out the result in one piece, under the lock of the stream so that results of several threads never mix
+ */
+static void endResult(ResultBuffer *buffer) {
+    flockfile(buffer->stream);
+    fwrite(buffer->bytes, 1, buffer->used, buffer->stream);
+    funlockfile(buffer->stream);
+}
+
+void emitMap(const char *name, TruthTable *map) {
+    size_t n = map->n;
+    ResultBuffer buffer;
+    beginResult(&buffer, strlen(name) + RESULT_OVERHEAD + NUMBER_BYTES * (1L << n));
+    switch (sinkFormat) {
+        case RESULTS_TEXT:
+            appendString(&buffer, name);
+            appendString(&buffer, ":\n");
+            for (size_t x = 0; x < 1L << n; ++x) {
+                if (x > 0) appendString(&buffer, " ");
+                appendNumber(&buffer, map->elements[x]);
+            }
+            appendString(&buffer, "\n\n");
+            break;
+        case RESULTS_JSON:
+            appendString(&buffer, "{\"name\":\"");
+            appendString(&buffer, name);
+            appendString(&buffer, "\",\"n\":");
+            appendNumber(&buffer, n);
+            appendString(&buffer, ",\"map\":[");
+            for (size_t x = 0; x < 1L << n; ++x) {
+                if (x > 0) appendString(&buffer, ",");
+                appendNumber(&buffer, map->elements[x]);
+            }
+            appendString(&buffer, "]}\n");
+            break;
+        case RESULTS_BINARY:
+            appendRecordHeader(&buffer, 'M', name);
+            appendLittleEndian(&buffer, n, 1);
+            for (size_t x = 0; x < 1L << n; ++x) {
+                appendLittleEndian(&buffer, map->elements[x], (n + 7) / 8);
+            }
+            break;
+    }
+    endResult(&buffer);
+}
+
+void emitConstant(const char *name, size_t value) {
+    ResultBuffer buffer;
+    beginResult(&buffer, strlen(name) + RESULT_OVERHEAD + NUMBER_BYTES);
+    switch (sinkFormat) {
+        case RESULTS_TEXT:
+            appendString(&buffer, name);
+            appendString(&buffer, ":\n");
+            appendNumber(&buffer, value);
+            appendString(&buffer, "\n\n");
+            break;
+        case RESULTS_JSON:
+            appendString(&buffer, "{\"name\":\"");
+            appendString(&buffer, name);
+            appendString(&buffer, "\",\"value\":");
+            appendNumber(&buffer, value);
+            appendString(&buffer, "}\n");
+            break;
+        case RESULTS_BINARY:
+            appendRecordHeader(&buffer, 'C', name);
+            appendLittleEndian(&buffer, value, 8);
+            break;
+    }
+    endResult(&buffer);
+}
+
+void closeResultSink(void) {
+    // The buffers of the other threads are freed when they exit, but the calling thread may well not exit before
+    pthread_once(&bufferKeyCreated, createBufferKey);
+    ThreadBuffer *buffer = pthread_getspecific(bufferKey);
+    if (buffer != NULL) {
+        destroyThreadBuffer(buffer);
+        pthread_setspecific(bufferKey, NULL);
+    }
+    fflush(sinkStream());
+    if (sinkFile != NULL) {
+        fclose(sinkFile);
+        sinkFile = NULL;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef AFFINE_OUTPUT_H
+#define AFFINE_OUTPUT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "structures.h"
+
+/**
+ * In output, you will find the sink that the results of the searches are written to: the maps of an equivalence and
+ * the constants that go with them. Each thread formats its results without printf into a buffer of its own, kept
+ * from one result to the next, and each result is written in one piece while holding the lock of the stream, so that
+ * results emitted by several threads never mix. The messages of
+ * the programs still go to standard output with printf.
+ */
+
+/**
+ * How the results are written
+ */
+typedef enum ResultFormat {
+    RESULTS_TEXT, // "L1:" on one line, the values of the map on the next, then an empty line
+    RESULTS_JSON, // One JSON object per line, {"name":"L1","n":6,"map":[...]} or {"name":"c1","value":5}
+    RESULTS_BINARY // The header RESULTS_MAGIC, then one record per result, see emitMap and emitConstant
+} ResultFormat;
+
+/**
+ * The first bytes of a file of binary results, which change with the layout of the records
+ */
+#define RESULTS_MAGIC "AFFRES01"
+
+/**
+ * Choose where and how the results are written. The sink writes text to standard output until it is opened.
+ * @param format The format of the results
+ * @param file The file to write the results to, NULL for standard output
+ * @return False if the file cannot be opened
+ */
+bool openResultSink(ResultFormat format, const char *file);
+
+/**
+ * Write a map found by a search. A binary record is the byte 'M', the length of the name in one byte, the name, the
+ * dimension n in one byte, and the 2^n values, each in (n + 7) / 8 bytes, least significant byte first.
+ * @param name The name of the map, such as L1 or A2, at most 255 characters
+ * @param map The map
+ */
+void emitMap(const char *name, TruthTable *map);
+
+/**
+ * Write a constant found by a search. A binary record is the byte 'C', the length of the name in one byte, the name,
+ * and the value in 8 bytes, least significant byte first.
+ * @param name The name of the constant, such as c1, at most 255 characters
+ * @param value The value of the constant
+ */
+void emitConstant(const char *name, size_t value);
+
+/**
+ * Write out the results that are still buffered, and close the file of the results
+ */
+void closeResultSink(void);
+
+#endif //AFFINE_OUTPUT_H
@@ -0,0 +1,216 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "structures.h"
+#include "control.h"
+#include "output.h"
+#include "permutation.h"
+#include "bitslice.h"
+
+PartialLinearMap *initPartialLinearMap(size_t n) {
+    PartialLinearMap *map = malloc(sizeof(PartialLinearMap));
+    map->n = n;
+    map->points = malloc(sizeof(size_t) * 1L << n);
+    map->values = malloc(sizeof(size_t) * 1L << n);
+    map->known = calloc(sizeof(bool), 1L << n);
+    map->usedImages = calloc(sizeof(bool), 1L << n);
+    // A linear map always maps 0 -> 0
+    map->points[0] = 0;
+    map->values[0] = 0;
+    map->known[0] = true;
+    map->usedImages[0] = true;
+    map->count = 1;
+    return map;
+}
+
+void destroyPartialLinearMap(PartialLinearMap *map) {
+    free(map->points);
+    free(map->values);
+    free(map->known);
+    free(map->usedImages);
+    free(map);
+}
+
+bool addPoint(PartialLinearMap *map, size_t x, size_t y) {
+    if (map->known[x]) return map->values[x] == y;
+    if (map->usedImages[y]) return false;
+    size_t count = map->count;
+    for (size_t i = 0; i < count; ++i) {
+        size_t input = map->points[i] ^ x;
+        size_t value = map->values[map->points[i]] ^ y;
+        if (map->usedImages[value]) {
+            // Two inputs map to the same value; keep the map consistent so that it can be reset
+            map->count = count + i;
+            return false;
+        }
+        map->points[count + i] = input;
+        map->values[input] = value;
+        map->known[input] = true;
+        map->usedImages[value] = true;
+    }
+    map->count = 2 * count;
+    return true;
+}
+
+void resetPoints(PartialLinearMap *map, size_t count) {
+    for (size_t i = count; i < map->count; ++i) {
+        size_t x = map->points[i];
+        map->known[x] = false;
+        map->usedImages[map->values[x]] = false;
+    }
+    map->count = count;
+}
+
+/**
+ * Propagate G(x) = L1(F(L2(x))) between the partial maps, until no new points are found. Every new point x of L2
+ * gives the point F(L2(x)) -> G(x) of L1, and every new point y -> z of L1 gives the point G^{-1}(z) -> F^{-1}(y)
+ * of L2.
+ * @param processedL2 Number of points of L2 that have been propagated, updated
+ * @param processedL1 Number of points of L1 that have been propagated, updated
+ * @return False if a contradiction was found
+ */
+static bool propagate(TruthTable *F, TruthTable *G, TruthTable *inverseF, TruthTable *inverseG, PartialLinearMap *L1,
+                      PartialLinearMap *L2, size_t *processedL1, size_t *processedL2) {
+    while (*processedL2 < L2->count || *processedL1 < L1->count) {
+        if (*processedL2 < L2->count) {
+            size_t x = L2->points[(*processedL2)++];
+            if (!addPoint(L1, F->elements[L2->values[x]], G->elements[x])) return false;
+        } else {
+            size_t y = L1->points[(*processedL1)++];
+            if (!addPoint(L2, inverseG->elements[L1->values[y]], inverseF->elements[y])) return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Guess the value of L2 on the smallest basis element that is not known yet, propagate, and recurse.
+ */
+static bool guessAndPropagate(TruthTable *F, TruthTable *G, TruthTable *inverseF, TruthTable *inverseG,
+                              PartialLinearMap *L1, PartialLinearMap *L2, size_t processedL1, size_t processedL2,
+                              SearchControl *control) {
+    size_t n = F->n;
+    if (!propagate(F, G, inverseF, inverseG, L1, L2, &processedL1, &processedL2)) return false;
+    if (L2->count == 1L << n) return true;
+    if (searchShouldStop(control)) return false;
+
+    size_t basisElement = 1;
+    while (L2->known[basisElement]) basisElement <<= 1;
+
+    size_t countL1 = L1->count;
+    size_t countL2 = L2->count;
+    for (size_t value = 1; value < 1L << n; ++value) {
+        if (L2->usedImages[value]) continue;
+        if (addPoint(L2, basisElement, value) &&
+            guessAndPropagate(F, G, inverseF, inverseG, L1, L2, processedL1, processedL2, control)) {
+            return true;
+        }
+        resetPoints(L1, countL1);
+        resetPoints(L2, countL2);
+        if (control->status != SEARCH_RUNNING) return false;
+    }
+    return false;
+}
+
+bool linearEquivalencePermutations(TruthTable *F, TruthTable *G, TruthTable *inverseF, TruthTable *inverseG,
+                                   TruthTable *L1, TruthTable *L2, SearchControl *control) {
+    size_t n = F->n;
+    PartialLinearMap *partialL1 = initPartialLinearMap(n);
+    PartialLinearMap *partialL2 = initPartialLinearMap(n);
+
+    bool found = guessAndPropagate(F, G, inverseF, inverseG, partialL1, partialL2, 0, 0, control);
+    if (found) {
+        memcpy(L1->elements, partialL1->values, sizeof(size_t) * 1L << n);
+        memcpy(L2->elements, partialL2->values, sizeof(size_t) * 1L << n);
+    }
+    destroyPartialLinearMap(partialL1);
+    destroyPartialLinearMap(partialL2);
+    return found;
+}
+
+bool searchLinearPermutations(TruthTable *F, TruthTable *G, SearchControl *control) {
+    size_t n = F->n;
+    if (!beginSearchStage(control, "linear-permutation", 1)) return false;
+    TruthTable *inverseF = inverse(F);
+    TruthTable *inverseG = inverse(G);
+    TruthTable *L1 = initTruthTable(n);
+    TruthTable *L2 = initTruthTable(n);
+
+    bool found = linearEquivalencePermutations(F, G, inverseF, inverseG, L1, L2, control);
+    if (found) {
+        emitMap("L1", L1);
+        emitMap("L2", L2);
+    }
+
+    destroyTruthTable(inverseF);
+    destroyTruthTable(inverseG);
+    destroyTruthTable(L1);
+    destroyTruthTable(L2);
+    return found;
+}
+
+/**
+ * Count the pairs (x, y) where the second derivative F(x + a) + F(y + a) + F(x + y + a) + F(a) is zero. This is the
+ * number of pairs where F(x + a) + F(a) is additive, which is invariant under linear equivalence. For each x, the
+ * pairs are the solutions z = y + a of F(z) + F(z + x) = F(x + a) + F(a).
+ */
+static size_t additivePairs(BitSlicedTruthTable *sliced, TruthTable *F, size_t a) {
+    size_t count = 0;
+    for (size_t x = 0; x < 1L << F->n; ++x) {
+        count += countDerivativeSolutions(sliced, x, F->elements[x ^ a] ^ F->elements[a]);
+    }
+    return count;
+}
+
+bool searchPermutations(TruthTable *F, TruthTable *G, SearchControl *control) {
+    size_t n = F->n;
+    if (!beginSearchStage(control, "permutation", 1L << n)) return false;
+
+    /* G(x) = L1(F(L2(x) + a)) + b. Evaluating at 0 gives b = L1(F(a)) + G(0), so
+     * G(x) + G(0) = L1(F(L2(x) + a) + F(a)), a linear equivalence between Fa and G0 for each constant a. */
+    TruthTable *G0 = initTruthTable(n); // G(x) + G(0)
+    TruthTable *Fa = initTruthTable(n); // F(x + a) + F(a)
+    for (size_t x = 0; x < 1L << n; ++x) {
+        G0->elements[x] = G->elements[x] ^ G->elements[0];
+    }
+    TruthTable *inverseG0 = inverse(G0);
+    TruthTable *inverseFa = initTruthTable(n);
+    TruthTable *L1 = initTruthTable(n);
+    TruthTable *L2 = initTruthTable(n);
+    BitSlicedTruthTable *slicedF = bitSlice(F);
+    BitSlicedTruthTable *slicedG = bitSlice(G);
+    size_t pairsG = additivePairs(slicedG, G, 0);
+
+    bool found = false;
+    for (size_t a = control->c1; a < 1L << n; ++a) {
+        if (!shardOwnsConstant(control, a)) continue; // The constant belongs to another shard
+        control->c1 = a;
+        // Fa and G0 can only be linear equivalent if they have the same number of additive pairs
+        if (additivePairs(slicedF, F, a) != pairsG) continue;
+        for (size_t x = 0; x < 1L << n; ++x) {
+            size_t y = F->elements[x ^ a] ^ F->elements[a];
+            Fa->elements[x] = y;
+            inverseFa->elements[y] = x;
+        }
+        found = linearEquivalencePermutations(Fa, G0, inverseFa, inverseG0, L1, L2, control);
+        if (found) {
+            // A1(y) = L1(y) + b and A2(x) = L2(x) + a
+            size_t b = L1->elements[F->elements[a]] ^ G->elements[0];
+            addConstant(L1, b);
+            addConstant(L2, a);
+            emitMap("A1", L1);
+            emitMap("A2", L2);
+        }
+        if (found || control->status != SEARCH_RUNNING) break;
+    }
+
+    destroyBitSlicedTruthTable(slicedF);
+    destroyBitSlicedTruthTable(slicedG);
+    destroyTruthTable(G0);
+    destroyTruthTable(Fa);
+    destroyTruthTable(inverseG0);
+    destroyTruthTable(inverseFa);
+    destroyTruthTable(L1);
+    destroyTruthTable(L2);
+    return found;
+}
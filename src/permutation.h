@@ -0,0 +1,91 @@
+#ifndef AFFINE_PERMUTATION_H
+#define AFFINE_PERMUTATION_H
+
+#include "structures.h"
+#include "control.h"
+
+/**
+ * In permutation, you will find a dedicated engine for permutations, in the style of the linear and affine equivalence
+ * algorithms of Biryukov, De Canniere, Braeken and Preneel. Instead of partitioning the functions (the partition of a
+ * permutation is a single bucket), the engine guesses a few values of L2 and propagates the relation
+ * G * L2^{-1} = L1 * F through the inverse tables of F and G, until the maps are complete or a contradiction is found.
+ */
+
+/**
+ * A linear map that is known on a subspace. The known inputs always form a subspace, and are stored in the order in
+ * which they became known.
+ */
+typedef struct PartialLinearMap {
+    size_t n; // Dimension
+    size_t count; // Number of known inputs, always a power of two
+    size_t *points; // The known inputs
+    size_t *values; // The values of the map on the known inputs, indexed by input
+    bool *known; // known[x] is true if the value of x is known
+    bool *usedImages; // usedImages[y] is true if y is the value of a known input
+} PartialLinearMap;
+
+/**
+ * Initialize a new partial linear map where only 0 -> 0 is known
+ * @param n The dimension
+ * @return A new partial linear map
+ */
+PartialLinearMap *initPartialLinearMap(size_t n);
+
+/**
+ * Free the memory allocated for the partial linear map
+ * @param map The partial linear map to destroy
+ */
+void destroyPartialLinearMap(PartialLinearMap *map);
+
+/**
+ * Add the pair x -> y to a partial linear map, and extend the map by linearity to the span of the known inputs and x.
+ * The new inputs are appended to the list of points, where the propagation picks them up.
+ * @param map The partial linear map
+ * @param x The input
+ * @param y The value of x
+ * @return False if the pair contradicts the map, i.e. if the map would not be a linear permutation
+ */
+bool addPoint(PartialLinearMap *map, size_t x, size_t y);
+
+/**
+ * Forget all the points added after the first count points
+ * @param map The partial linear map
+ * @param count The number of points to keep
+ */
+void resetPoints(PartialLinearMap *map, size_t count);
+
+/**
+ * Search for linear permutations L1, L2 such that G = L1 * F * L2, where F and G are permutations.
+ * @param F The permutation F
+ * @param G The permutation G
+ * @param inverseF The inverse of F
+ * @param inverseG The inverse of G
+ * @param L1 Truth table that receives the outer permutation
+ * @param L2 Truth table that receives the inner permutation
+ * @param control The search control, polled for time budgets and cancellation
+ * @return True if an equivalence was found
+ */
+bool linearEquivalencePermutations(TruthTable *F, TruthTable *G, TruthTable *inverseF, TruthTable *inverseG,
+                                   TruthTable *L1, TruthTable *L2, SearchControl *control);
+
+/**
+ * Search for affine permutations A1, A2 such that G = A1 * F * A2, where F and G are permutations. For each constant
+ * a of A2, the constant of A1 is determined, and the problem reduces to a linear equivalence between
+ * F(x + a) + F(a) and G(x) + G(0).
+ * @param F The permutation F
+ * @param G The permutation G
+ * @param control The search control
+ * @return True if an equivalence was found, in which case A1 and A2 are printed
+ */
+bool searchPermutations(TruthTable *F, TruthTable *G, SearchControl *control);
+
+/**
+ * Search for linear permutations L1, L2 such that G = L1 * F * L2, where F and G are permutations.
+ * @param F The permutation F
+ * @param G The permutation G
+ * @param control The search control
+ * @return True if an equivalence was found, in which case L1 and L2 are printed
+ */
+bool searchLinearPermutations(TruthTable *F, TruthTable *G, SearchControl *control);
+
+#endif //AFFINE_PERMUTATION_H
@@ -0,0 +1,93 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "structures.h"
+#include "equivalence.h"
+#include "prefetch.h"
+
+/**
+ * The reader thread: parse the files in order, waiting while the ring is full
+ */
+static void *readAhead(void *argument) {
+    InputPrefetch *prefetch = argument;
+    pthread_mutex_lock(&prefetch->lock);
+    while (!prefetch->stopped && prefetch->read < prefetch->count) {
+        if (prefetch->read - prefetch->taken == prefetch->depth) {
+            pthread_cond_wait(&prefetch->emptied, &prefetch->lock);
+            continue;
+        }
+        // The caller only looks at the slot once the file is counted as read, so it is parsed without the lock
+        size_t i = prefetch->read;
+        PrefetchedInput *slot = &prefetch->ring[i % prefetch->depth];
+        pthread_mutex_unlock(&prefetch->lock);
+        slot->function = readFile(prefetch->files[i], slot->error);
+        pthread_mutex_lock(&prefetch->lock);
+        prefetch->read += 1;
+        // The caller exits at a file that cannot be parsed, so there is no need to read further
+        if (slot->function == NULL) prefetch->stopped = true;
+        pthread_cond_signal(&prefetch->filled);
+    }
+    pthread_mutex_unlock(&prefetch->lock);
+    return NULL;
+}
+
+InputPrefetch *initInputPrefetch(char **files, size_t count, size_t depth) {
+    InputPrefetch *prefetch = malloc(sizeof(InputPrefetch));
+    prefetch->files = files;
+    prefetch->count = count;
+    prefetch->depth = depth < count ? depth : count;
+    prefetch->read = 0;
+    prefetch->taken = 0;
+    prefetch->stopped = false;
+    prefetch->ring = NULL;
+    if (prefetch->depth == 0) return prefetch;
+
+    prefetch->ring = malloc(sizeof(PrefetchedInput) * prefetch->depth);
+    pthread_mutex_init(&prefetch->lock, NULL);
+    pthread_cond_init(&prefetch->filled, NULL);
+    pthread_cond_init(&prefetch->emptied, NULL);
+    pthread_create(&prefetch->reader, NULL, readAhead, prefetch);
+    return prefetch;
+}
+
+TruthTable *nextPrefetchedInput(InputPrefetch *prefetch) {
+    if (prefetch->depth == 0) return parseFile(prefetch->files[prefetch->taken++]);
+
+    pthread_mutex_lock(&prefetch->lock);
+    while (prefetch->read == prefetch->taken) {
+        pthread_cond_wait(&prefetch->filled, &prefetch->lock);
+    }
+    PrefetchedInput *slot = &prefetch->ring[prefetch->taken % prefetch->depth];
+    TruthTable *function = slot->function;
+    prefetch->taken += 1;
+    pthread_cond_signal(&prefetch->emptied);
+    pthread_mutex_unlock(&prefetch->lock);
+
+    // The reader stopped at this file, so the slot is not written again
+    if (function == NULL) {
+        printf("%s\n", slot->error);
+        exit(1);
+    }
+    return function;
+}
+
+void destroyInputPrefetch(InputPrefetch *prefetch) {
+    if (prefetch->depth > 0) {
+        pthread_mutex_lock(&prefetch->lock);
+        prefetch->stopped = true;
+        pthread_cond_signal(&prefetch->emptied);
+        pthread_mutex_unlock(&prefetch->lock);
+        pthread_join(prefetch->reader, NULL);
+
+        for (size_t i = prefetch->taken; i < prefetch->read; ++i) {
+            TruthTable *function = prefetch->ring[i % prefetch->depth].function;
+            if (function != NULL) destroyTruthTable(function);
+        }
+        free(prefetch->ring);
+        pthread_mutex_destroy(&prefetch->lock);
+        pthread_cond_destroy(&prefetch->filled);
+        pthread_cond_destroy(&prefetch->emptied);
+    }
+    free(prefetch);
+}
@@ -0,0 +1,64 @@
+#ifndef AFFINE_PREFETCH_H
+#define AFFINE_PREFETCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "structures.h"
+#include "equivalence.h"
+
+/**
+ * In prefetch, you will find the reader stage of the programs that go through many files: a thread that opens and
+ * parses the next files while the current function is searched, and keeps them in a bounded ring. When the search
+ * falls behind, the ring fills up and the reader waits, so at most a fixed number of functions are held in memory.
+ */
+
+/**
+ * A file read ahead of time
+ */
+typedef struct PrefetchedInput {
+    TruthTable *function; // The parsed function, NULL if the file could not be parsed
+    char error[READ_ERROR_SIZE]; // Why the file could not be parsed
+} PrefetchedInput;
+
+/**
+ * The reader stage over a list of files, which hands out the functions in the order of the files
+ */
+typedef struct InputPrefetch {
+    char **files; // The files to read
+    size_t count; // Number of files
+    size_t depth; // Number of functions that may be read ahead, 0 to read each file when it is asked for
+    PrefetchedInput *ring; // The functions read ahead, file i being in slot i % depth
+    size_t read; // Number of files read by the reader so far
+    size_t taken; // Number of functions taken by the caller so far
+    bool stopped; // True once the reader should stop, because of an error or because the caller is done
+    pthread_t reader; // The reader thread, if depth > 0
+    pthread_mutex_t lock; // Protects the ring and the counters
+    pthread_cond_t filled; // Signaled when the reader has put a function in the ring
+    pthread_cond_t emptied; // Signaled when the caller has taken a function from the ring, or stops the reader
+} InputPrefetch;
+
+/**
+ * Start reading the files ahead of time
+ * @param files The files to read, which must stay valid until the prefetch is destroyed
+ * @param count Number of files
+ * @param depth Number of functions that may be read ahead, 0 to read each file on the calling thread
+ * @return A new prefetch
+ */
+InputPrefetch *initInputPrefetch(char **files, size_t count, size_t depth);
+
+/**
+ * Take the function of the next file, waiting for the reader if it is not parsed yet. As with parseFile, the program
+ * exits if the file cannot be parsed.
+ * @param prefetch The prefetch, which must have files left
+ * @return The function of the next file, owned by the caller
+ */
+TruthTable *nextPrefetchedInput(InputPrefetch *prefetch);
+
+/**
+ * Stop the reader, and free the memory allocated for the prefetch and the functions that were not taken
+ * @param prefetch The prefetch to destroy
+ */
+void destroyInputPrefetch(InputPrefetch *prefetch);
+
+#endif //AFFINE_PREFETCH_H
@@ -0,0 +1,264 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "structures.h"
+#include "dispatch.h"
+#include "store.h"
+
+/**
+ * The partition of a prepared function that a partition section holds
+ */
+static Partition **sectionPartition(PreparedFunction *F, StoreSection section) {
+    switch (section) {
+        case SECTION_PARTITION:
+            return &F->partition;
+        case SECTION_ORTHODERIVATIVE_PARTITION:
+            return &F->orthoderivativePartition;
+        case SECTION_INPUT_PARTITION:
+            return &F->inputPartition;
+        case SECTION_ORTHODERIVATIVE_INPUT_PARTITION:
+            return &F->orthoderivativeInputPartition;
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * Add words to a hash, in the same way as hashTruthTable
+ */
+static uint64_t hashWords(uint64_t hash, const size_t *words, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        hash ^= words[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Write words to the store, and add them to the hash of its content
+ */
+static void writeWords(FILE *file, const size_t *words, size_t count, uint64_t *hash) {
+    fwrite(words, sizeof(size_t), count, file);
+    *hash = hashWords(*hash, words, count);
+}
+
+/**
+ * The number of words of a partition section with the given number of buckets
+ */
+static size_t partitionWords(size_t numBuckets, size_t n) {
+    return 1 + 3 * numBuckets + 1 + 2 * (1L << n);
+}
+
+bool publishPreparedFunction(PreparedFunction *F, const char *path) {
+    size_t n = F->function->n;
+    size_t entries = 1L << n;
+    StoreHeader header;
+    memset(&header, 0, sizeof(StoreHeader));
+    memcpy(header.magic, STORE_MAGIC, sizeof(header.magic));
+    header.version = STORE_VERSION;
+    header.wordSize = sizeof(size_t);
+    header.functionHash = hashTruthTable(14695981039346656037ULL, F->function);
+    header.n = n;
+    header.permutation = F->permutation;
+    header.degree = F->degree;
+    for (size_t i = 0; i < MAX_DIMENSION; ++i) header.coordinateDegrees[i] = F->degrees.coordinateDegrees[i];
+    for (size_t d = 0; d < MAX_DIMENSION + 2; ++d) header.degreeRanks[d] = F->degrees.ranks[d];
+    header.quadraticApn = F->quadraticApn;
+    header.orthoderivativeComputed = F->orthoderivativeComputed;
+
+    // The sections follow the header in their order, and only the parts that have been computed are written
+    size_t offset = sizeof(StoreHeader);
+    header.sections[SECTION_FUNCTION] = offset;
+    offset += sizeof(size_t) * entries;
+    if (F->orthoderivative != NULL) {
+        header.sections[SECTION_ORTHODERIVATIVE] = offset;
+        offset += sizeof(size_t) * entries;
+    }
+    for (StoreSection section = SECTION_PARTITION; section < STORE_SECTIONS; ++section) {
+        Partition *partition = *sectionPartition(F, section);
+        if (partition == NULL) continue;
+        header.sections[section] = offset;
+        offset += sizeof(size_t) * partitionWords(partition->numBuckets, n);
+    }
+    header.size = offset;
+
+    // Written next to the store and renamed, so that other processes see either the old store or the whole new one
+    size_t length = strlen(path) + 32;
+    char *temporary = malloc(length);
+    snprintf(temporary, length, "%s.%ld.tmp", path, (long) getpid());
+    FILE *file = fopen(temporary, "wb");
+    if (file == NULL) {
+        printf("Store: cannot write %s\n", temporary);
+        free(temporary);
+        return false;
+    }
+    uint64_t hash = 14695981039346656037ULL;
+    fwrite(&header, sizeof(StoreHeader), 1, file);
+    writeWords(file, F->function->elements, entries, &hash);
+    if (F->orthoderivative != NULL) writeWords(file, F->orthoderivative->elements, entries, &hash);
+    for (StoreSection section = SECTION_PARTITION; section < STORE_SECTIONS; ++section) {
+        Partition *partition = *sectionPartition(F, section);
+        if (partition == NULL) continue;
+        writeWords(file, &partition->numBuckets, 1, &hash);
+        writeWords(file, partition->multiplicities, partition->numBuckets, &hash);
+        writeWords(file, partition->bucketSizes, partition->numBuckets, &hash);
+        writeWords(file, partition->offsets, partition->numBuckets + 1, &hash);
+        writeWords(file, partition->elements, entries, &hash);
+        writeWords(file, partition->bucketOf, entries, &hash);
+    }
+    header.contentHash = hash;
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(StoreHeader), 1, file);
+
+    bool written = !ferror(file);
+    written = fclose(file) == 0 && written;
+    written = written && rename(temporary, path) == 0;
+    if (written) {
+        printf("Store: F published to %s\n", path);
+    } else {
+        printf("Store: cannot write %s\n", path);
+        remove(temporary);
+    }
+    free(temporary);
+    return written;
+}
+
+/**
+ * Check a mapped store before it is used
+ * @return Why the store cannot be used, or NULL if it can
+ */
+static const char *storeProblem(const StoreHeader *header, size_t size, TruthTable *F) {
+    if (memcmp(header->magic, STORE_MAGIC, sizeof(header->magic)) != 0) return "is not a store";
+    if (header->version != STORE_VERSION || header->wordSize != sizeof(size_t)) {
+        return "was written by another version";
+    }
+    if (header->n != F->n || header->functionHash != hashTruthTable(14695981039346656037ULL, F)) {
+        return "holds another function";
+    }
+    if (header->size != size || (size - sizeof(StoreHeader)) % sizeof(size_t) != 0) return "is damaged";
+
+    // Every section must lie within the store
+    size_t entries = 1L << F->n;
+    for (StoreSection section = SECTION_FUNCTION; section < STORE_SECTIONS; ++section) {
+        size_t offset = header->sections[section];
+        if (offset == 0) continue;
+        if (offset < sizeof(StoreHeader) || offset % sizeof(size_t) != 0 || offset + sizeof(size_t) > size) {
+            return "is damaged";
+        }
+        size_t words = entries;
+        if (section >= SECTION_PARTITION) {
+            size_t numBuckets = *(const size_t *) ((const char *) header + offset);
+            if (numBuckets > entries + 1) return "is damaged";
+            words = partitionWords(numBuckets, F->n);
+        }
+        if (words > (size - offset) / sizeof(size_t)) return "is damaged";
+    }
+    if (header->sections[SECTION_FUNCTION] == 0) return "is damaged";
+
+    const size_t *content = (const size_t *) (header + 1);
+    size_t words = (size - sizeof(StoreHeader)) / sizeof(size_t);
+    if (hashWords(14695981039346656037ULL, content, words) != header->contentHash) return "is damaged";
+    return NULL;
+}
+
+/**
+ * A truth table whose elements are in the store
+ */
+static TruthTable *mappedTruthTable(void *base, size_t offset, size_t n) {
+    TruthTable *tt = malloc(sizeof(TruthTable));
+    tt->n = n;
+    tt->elements = (size_t *) ((char *) base + offset);
+    return tt;
+}
+
+/**
+ * A partition whose lists are in the store. It is only read, so it has no work space.
+ */
+static Partition *mappedPartition(void *base, size_t offset, size_t n) {
+    size_t *words = (size_t *) ((char *) base + offset);
+    Partition *partition = malloc(sizeof(Partition));
+    partition->n = n;
+    partition->numBuckets = words[0];
+    partition->multiplicities = words + 1;
+    partition->bucketSizes = partition->multiplicities + partition->numBuckets;
+    partition->offsets = partition->bucketSizes + partition->numBuckets;
+    partition->elements = partition->offsets + partition->numBuckets + 1;
+    partition->bucketOf = partition->elements + (1L << n);
+    partition->occurrences = NULL;
+    partition->bucketOfMultiplicity = NULL;
+    return partition;
+}
+
+PreparedFunction *attachPreparedFunction(const char *path, TruthTable *F) {
+    if (path == NULL) return NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL; // Nothing was published yet
+    struct stat status;
+    if (fstat(fd, &status) != 0 || (size_t) status.st_size < sizeof(StoreHeader)) {
+        close(fd);
+        printf("Store: %s is damaged, it is published again\n", path);
+        return NULL;
+    }
+    size_t size = (size_t) status.st_size;
+    void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    const StoreHeader *header = base;
+    const char *problem = storeProblem(header, size, F);
+    if (problem != NULL) {
+        printf("Store: %s %s, it is published again\n", path, problem);
+        munmap(base, size);
+        return NULL;
+    }
+
+    size_t n = F->n;
+    SharedStore *store = malloc(sizeof(SharedStore));
+    store->base = base;
+    store->size = size;
+    store->orthoderivative = header->sections[SECTION_ORTHODERIVATIVE] != 0 ?
+                             mappedTruthTable(base, header->sections[SECTION_ORTHODERIVATIVE], n) : NULL;
+
+    PreparedFunction *prepared = malloc(sizeof(PreparedFunction));
+    prepared->function = F; // F has the hash of the function in the store, and stands in for it
+    prepared->permutation = header->permutation != 0;
+    prepared->degree = header->degree;
+    prepared->degrees.degree = header->degree;
+    for (size_t i = 0; i < MAX_DIMENSION; ++i) prepared->degrees.coordinateDegrees[i] = header->coordinateDegrees[i];
+    for (size_t d = 0; d < MAX_DIMENSION + 2; ++d) prepared->degrees.ranks[d] = header->degreeRanks[d];
+    prepared->quadraticApn = header->quadraticApn != 0;
+    prepared->orthoderivativeComputed = header->orthoderivativeComputed != 0;
+    prepared->orthoderivative = store->orthoderivative;
+    for (StoreSection section = SECTION_PARTITION; section < STORE_SECTIONS; ++section) {
+        size_t offset = header->sections[section];
+        Partition *partition = offset != 0 ? mappedPartition(base, offset, n) : NULL;
+        store->partitions[section - SECTION_PARTITION] = partition;
+        *sectionPartition(prepared, section) = partition;
+    }
+    prepared->orbit = NULL;
+    prepared->orthoderivativeOrbit = NULL;
+    prepared->store = store;
+    printf("Store: F attached from %s\n", path);
+    return prepared;
+}
+
+void detachPreparedFunction(PreparedFunction *F) {
+    SharedStore *store = F->store;
+    if (F->orthoderivative == store->orthoderivative) F->orthoderivative = NULL;
+    free(store->orthoderivative);
+    for (StoreSection section = SECTION_PARTITION; section < STORE_SECTIONS; ++section) {
+        Partition **partition = sectionPartition(F, section);
+        Partition *mapped = store->partitions[section - SECTION_PARTITION];
+        if (*partition == mapped) *partition = NULL;
+        free(mapped);
+    }
+    munmap(store->base, store->size);
+    free(store);
+    F->store = NULL;
+}
@@ -0,0 +1,98 @@
+#ifndef AFFINE_STORE_H
+#define AFFINE_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "structures.h"
+#include "dispatch.h"
+
+/**
+ * In store, you will find a file that holds a prepared function, so that processes searching against the same function
+ * F do not each compute its orthoderivative and partitions again. The first process publishes what it prepared, and
+ * the others map the file read-only and use its tables in place: every part is found by its offset from the start of
+ * the file, so the file can be mapped at any address, and nothing is copied or parsed. Placed on a memory file system
+ * such as /dev/shm, the file is a shared-memory segment that all the processes of a host map.
+ */
+
+/**
+ * The first bytes of a store
+ */
+#define STORE_MAGIC "AFFSTORE"
+
+/**
+ * The version of the layout of a store, raised whenever the layout changes, so that older stores are rebuilt
+ */
+#define STORE_VERSION 2
+
+/**
+ * The parts of a prepared function that a store can hold
+ */
+typedef enum StoreSection {
+    SECTION_FUNCTION, // The truth table of the function
+    SECTION_ORTHODERIVATIVE, // The truth table of the orthoderivative
+    SECTION_PARTITION, // The partition of the function
+    SECTION_ORTHODERIVATIVE_PARTITION, // The partition of the orthoderivative
+    SECTION_INPUT_PARTITION, // The partition of the inputs of the function
+    SECTION_ORTHODERIVATIVE_INPUT_PARTITION, // The partition of the inputs of the orthoderivative
+    STORE_SECTIONS // Number of sections
+} StoreSection;
+
+/**
+ * The start of a store. A truth table section holds the 2^n values; a partition section holds the number of buckets
+ * b, then the multiplicities and sizes of the buckets, b words each, the b + 1 offsets, the 2^n elements and the 2^n
+ * buckets of the elements. All the words are of the size of a size_t.
+ */
+typedef struct StoreHeader {
+    char magic[8]; // STORE_MAGIC, without a terminating zero
+    uint64_t version; // STORE_VERSION
+    uint64_t wordSize; // The size of a word of the tables
+    uint64_t size; // The size of the whole store in bytes
+    uint64_t functionHash; // The hash of the function, to find out if the store was published for another function
+    uint64_t contentHash; // The hash of all the words after the header, to find out if the store is damaged
+    uint64_t n; // The dimension of the function
+    uint64_t permutation; // 1 if the function is a permutation
+    uint64_t degree; // The algebraic degree of the function
+    uint64_t coordinateDegrees[MAX_DIMENSION]; // The degrees of the coordinates of the function
+    uint64_t degreeRanks[MAX_DIMENSION + 2]; // The ranks of the degree profile of the function
+    uint64_t quadraticApn; // 1 if the function is quadratic and APN
+    uint64_t orthoderivativeComputed; // 1 if the orthoderivative was computed, even if it does not exist
+    uint64_t sections[STORE_SECTIONS]; // The offset of each section from the start of the store, 0 if it is absent
+} StoreHeader;
+
+/**
+ * A store mapped by a process, together with the parts of the prepared function that point into it
+ */
+typedef struct SharedStore {
+    void *base; // The start of the mapping
+    size_t size; // The size of the mapping
+    TruthTable *orthoderivative; // The truth table of the orthoderivative in the store, or NULL
+    Partition *partitions[4]; // The partitions in the store, in the order of their sections, or NULL
+} SharedStore;
+
+/**
+ * Write the parts of a prepared function that have been computed to a store. The store is written to a temporary file
+ * and then renamed, so processes never see a store that is only partly written.
+ * @param F The prepared function
+ * @param path The path of the store
+ * @return False if the store could not be written
+ */
+bool publishPreparedFunction(PreparedFunction *F, const char *path);
+
+/**
+ * Map a store read-only, and use it for the prepared function of F. A store that was written by another version, for
+ * another function, or that is damaged is ignored.
+ * @param path The path of the store, or NULL for none
+ * @param F The function F, which the prepared function takes over if the store is used, as with prepareFunction;
+ * otherwise it stays with the caller
+ * @return A new prepared function whose tables are in the store, or NULL if there is no store that can be used
+ */
+PreparedFunction *attachPreparedFunction(const char *path, TruthTable *F);
+
+/**
+ * Unmap the store of a prepared function. The parts that were in the store are set to NULL; the parts that were
+ * computed after the store was mapped are left to the prepared function.
+ * @param F The prepared function, which must have been attached to a store
+ */
+void detachPreparedFunction(PreparedFunction *F);
+
+#endif //AFFINE_STORE_H
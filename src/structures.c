@@ -38,48 +38,86 @@ TruthTable *inverse(TruthTable *f) {
     return inverse;
 }
 
+bool isPermutation(TruthTable *f) {
+    size_t dimension = f->n;
+    bool *seen = calloc(sizeof(bool), 1L << dimension);
+    bool permutation = true;
+    for (size_t x = 0; x < 1L << dimension; ++x) {
+        size_t y = f->elements[x];
+        if (seen[y]) {
+            permutation = false;
+            break;
+        }
+        seen[y] = true;
+    }
+    free(seen);
+    return permutation;
+}
+
+unsigned long long hashTruthTable(unsigned long long hash, TruthTable *tt) {
+    for (size_t x = 0; x < 1L << tt->n; ++x) {
+        hash ^= tt->elements[x];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+size_t algebraicDegree(TruthTable *f) {
+    size_t dimension = f->n;
+    size_t *anf = malloc(sizeof(size_t) * 1L << dimension);
+    memcpy(anf, f->elements, sizeof(size_t) * 1L << dimension);
+
+    // Moebius transform; all coordinate functions are transformed at once since they are the bits of the elements
+    for (size_t i = 0; i < dimension; ++i) {
+        for (size_t x = 0; x < 1L << dimension; ++x) {
+            if (x & 1L << i) {
+                anf[x] ^= anf[x ^ 1L << i];
+            }
+        }
+    }
+    size_t degree = 0;
+    for (size_t x = 0; x < 1L << dimension; ++x) {
+        if (anf[x] && __builtin_popcountl(x) > degree) {
+            degree = __builtin_popcountl(x);
+        }
+    }
+    free(anf);
+    return degree;
+}
+
 TruthTable *randomLinearFunction(size_t n) {
     size_t entries = 1L << n;
-    size_t listGenerated[entries];
+    TruthTable *newFunction = initTruthTable(n);
+    size_t *listGenerated = newFunction->elements;
     listGenerated[0] = 0;
-    size_t basisImages[n];
     for (size_t i = 0; i < n; ++i) {
         size_t j = rand() % entries;
-        basisImages[i] = j;
-        for (int k = 0; k < 1L << i; ++k) {
+        for (size_t k = 0; k < 1L << i; ++k) {
             listGenerated[(1L << i) + k] = listGenerated[k] ^ j;
         }
     }
-    TruthTable *newFunction = initTruthTable(n);
-    memcpy(newFunction->elements, listGenerated, sizeof(size_t) * entries);
     return newFunction;
 }
 
 TruthTable *randomLinearPermutation(size_t n) {
     size_t entries = 1L << n;
-    bool generated[entries];
-    size_t listGenerated[entries];
+    bool *generated = calloc(sizeof(bool), entries);
+    TruthTable *newFunction = initTruthTable(n);
+    size_t *listGenerated = newFunction->elements;
     generated[0] = true;
-    for (size_t i = 1; i < entries; ++i) {
-        generated[i] = false;
-    }
     listGenerated[0] = 0;
 
-    size_t basisImages[n];
-    for (int i = 0; i < n; ++i) {
+    for (size_t i = 0; i < n; ++i) {
         size_t j = rand() % entries;
         while (generated[j]) {
             j = (j + 1) % entries;
         }
-        basisImages[i] = j;
-        for (int k = 0; k < 1L << i; ++k) {
+        for (size_t k = 0; k < 1L << i; ++k) {
             listGenerated[1L << i ^ k] = listGenerated[k] ^ j;
             generated[listGenerated[k] ^ j] = true;
         }
     }
-    // Add a random constant to the new function, to create an affine function
-    TruthTable *newFunction = initTruthTable(n);
-    memcpy(newFunction->elements, listGenerated, sizeof(size_t) * entries);
+    free(generated);
     return newFunction;
 }
 
@@ -97,7 +135,7 @@ TruthTable *createAffineTruthTable(TruthTable *F) {
     size_t constant1 = rand() % entries;
     size_t constant2 = rand() % entries;
     size_t constant3 = rand() % entries;
-    for (int i = 0; i < entries; ++i) {
+    for (size_t i = 0; i < entries; ++i) {
         // Add the constant
         A1->elements[i] ^= constant1;
         A2->elements[i] ^= constant2;
@@ -116,6 +154,25 @@ TruthTable *createAffineTruthTable(TruthTable *F) {
     return G;
 }
 
+TruthTable *createAffineEquivalentFunction(TruthTable *F) {
+    size_t n = F->n;
+    TruthTable *A1 = randomLinearPermutation(n);
+    TruthTable *A2 = randomLinearPermutation(n);
+
+    // Add random constants to A1 and A2 to create affine permutations
+    addConstant(A1, rand() % (1L << n));
+    addConstant(A2, rand() % (1L << n));
+
+    TruthTable *temp = compose(F, A2);
+    TruthTable *G = compose(A1, temp);
+
+    destroyTruthTable(A1);
+    destroyTruthTable(A2);
+    destroyTruthTable(temp);
+
+    return G;
+}
+
 TruthTable *createLinearFunction(TruthTable *F) {
     size_t n = F->n;
     TruthTable *L1 = randomLinearPermutation(n);
@@ -132,14 +189,42 @@ TruthTable *createLinearFunction(TruthTable *F) {
 }
 
 void printTruthTable(TruthTable *tt) {
-    for (int i = 0; i < 1L << tt->n; ++i) {
-        if (i < (1L << tt->n) - 1) {
-            printf("%zu ", tt->elements[i]);
-        } else {
-            printf("%zu\n", tt->elements[i]);
+    writeTruthTable(tt, stdout);
+}
+
+/**
+ * The size of the buffer that the elements of a truth table are formatted into before they are written
+ */
+#define WRITE_BUFFER_SIZE 65536
+
+void writeTruthTable(TruthTable *tt, FILE *stream) {
+    char *buffer = malloc(WRITE_BUFFER_SIZE);
+    size_t used = 0;
+    for (size_t i = 0; i < 1L << tt->n; ++i) {
+        // An element takes at most 20 digits and a separator, and the last one is followed by an empty line
+        if (used + 22 > WRITE_BUFFER_SIZE) {
+            fwrite(buffer, 1, used, stream);
+            used = 0;
         }
+        used += formatNumber(tt->elements[i], buffer + used);
+        buffer[used++] = i < (1L << tt->n) - 1 ? ' ' : '\n';
     }
-    printf("\n");
+    buffer[used++] = '\n';
+    fwrite(buffer, 1, used, stream);
+    free(buffer);
+}
+
+size_t formatNumber(size_t value, char *out) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = digits[count - 1 - i];
+    }
+    return count;
 }
 
 void destroyTruthTable(TruthTable *tt) {
@@ -149,19 +234,26 @@ void destroyTruthTable(TruthTable *tt) {
 
 Partition *initPartition(size_t n) {
     Partition *partition = malloc(sizeof(Partition));
-    partition->multiplicities = malloc(sizeof(size_t) * n); // Malloc n lists
-    partition->bucketSizes = malloc(sizeof(size_t) * n); // Malloc n lists
-    partition->buckets = malloc(sizeof(size_t **) * n); // Malloc n lists of bucket lists.
+    partition->n = n;
     partition->numBuckets = 0;
+    // A function has at most 2^n + 1 distinct multiplicities, 0..2^n
+    partition->multiplicities = malloc(sizeof(size_t) * ((1L << n) + 1));
+    partition->bucketSizes = malloc(sizeof(size_t) * ((1L << n) + 1));
+    partition->offsets = malloc(sizeof(size_t) * ((1L << n) + 2));
+    partition->elements = malloc(sizeof(size_t) * 1L << n);
+    partition->bucketOf = malloc(sizeof(size_t) * 1L << n);
+    partition->occurrences = malloc(sizeof(size_t) * 1L << n);
+    partition->bucketOfMultiplicity = malloc(sizeof(size_t) * ((1L << n) + 1));
+    return partition;
 }
 
 void printPartitionBuckets(Partition *partition) {
-    for (int i = 0; i < partition->numBuckets; ++i) {
-        for (int j = 0; j < partition->bucketSizes[i]; ++j) {
-            if (j == partition->bucketSizes[i] - 1) {
-                printf("%zu\n", partition->buckets[i][j]);
+    for (size_t i = 0; i < partition->numBuckets; ++i) {
+        for (size_t j = partition->offsets[i]; j < partition->offsets[i + 1]; ++j) {
+            if (j == partition->offsets[i + 1] - 1) {
+                printf("%zu\n", partition->elements[j]);
             } else {
-                printf("%zu ", partition->buckets[i][j]);
+                printf("%zu ", partition->elements[j]);
             }
         }
     }
@@ -169,52 +261,104 @@ void printPartitionBuckets(Partition *partition) {
 }
 
 void printPartition(Partition *F) {
-    for (int i = 0; i < F->numBuckets; ++i) {
-        printf("Bucket #%d = %zu\n", i, F->multiplicities[i]);
+    for (size_t i = 0; i < F->numBuckets; ++i) {
+        printf("Bucket #%zu = %zu\n", i, F->multiplicities[i]);
     }
 }
 
 Partition *partitionTt(TruthTable *tt) {
-    size_t dimension = tt->n;
-    size_t *multiplicities = calloc(sizeof(size_t), 1L << dimension);
-    Partition *partition = initPartition(dimension);
-    countElements(tt, multiplicities);
-
-    for (int i = 0; i < 1L << dimension; ++i) {
-        size_t numBuckets = partition->numBuckets; // init value = 0
-        size_t multiplicity = multiplicities[i]; // Get i'th element in list of multiplicities
-
-        // Check if multiplicity is in bucket, if false; add multiplicity to bucket
-        bool multiplicityIsInBucket = false;
-        for (int b = 0; b < numBuckets; ++b) {
-            if (partition->multiplicities[b] == multiplicity) {
-                multiplicityIsInBucket = true;
-                size_t thisBucket = partition->bucketSizes[b];
-                partition->buckets[b][thisBucket] = i; // Add the element to the correct bucket
-                partition->bucketSizes[b] += 1;
-                break;
-            }
-        }
-        if (!multiplicityIsInBucket) {
-            // The current multiplicity is not in the lists; add a new bucket to the buckets list
-            partition->buckets[numBuckets] = malloc(sizeof(size_t) * 1L << dimension); // Allocate memory for a new bucket list
-            partition->bucketSizes[numBuckets] = 1; // Increase the number of buckets by 1
-            partition->multiplicities[numBuckets] = multiplicity; // Add the multiplicity of the new bucket
-            partition->buckets[numBuckets][0] = i; // Add the element that belongs to this bucket
-            partition->numBuckets += 1;
+    Partition *partition = initPartition(tt->n);
+    fillPartition(partition, tt);
+    return partition;
+}
+
+void fillPartition(Partition *partition, TruthTable *tt) {
+    size_t size = 1L << tt->n;
+    size_t *occurrences = partition->occurrences;
+    size_t *bucketOfMultiplicity = partition->bucketOfMultiplicity;
+
+    memset(occurrences, 0, sizeof(size_t) * size);
+    countElements(tt, occurrences);
+
+    // Count the elements of each multiplicity
+    memset(bucketOfMultiplicity, 0, sizeof(size_t) * (size + 1));
+    for (size_t y = 0; y < size; ++y) {
+        bucketOfMultiplicity[occurrences[y]] += 1;
+    }
+
+    // Give the multiplicities that occur a bucket each, in increasing order, and place the buckets one after the other
+    size_t numBuckets = 0;
+    size_t offset = 0;
+    for (size_t m = 0; m <= size; ++m) {
+        size_t bucketSize = bucketOfMultiplicity[m];
+        if (bucketSize == 0) continue;
+        partition->multiplicities[numBuckets] = m;
+        partition->bucketSizes[numBuckets] = 0; // Counts the elements placed so far, ends at bucketSize
+        partition->offsets[numBuckets] = offset;
+        bucketOfMultiplicity[m] = numBuckets;
+        offset += bucketSize;
+        numBuckets += 1;
+    }
+    partition->offsets[numBuckets] = offset;
+    partition->numBuckets = numBuckets;
+
+    // Place the elements, which keeps each bucket in increasing order
+    for (size_t y = 0; y < size; ++y) {
+        size_t bucket = bucketOfMultiplicity[occurrences[y]];
+        partition->elements[partition->offsets[bucket] + partition->bucketSizes[bucket]++] = y;
+        partition->bucketOf[y] = bucket;
+    }
+}
+
+/**
+ * An element together with its key, sorted by key first
+ */
+typedef struct KeyedElement {
+    size_t key; // The key of the element
+    size_t element; // The element
+} KeyedElement;
+
+static int compareKeyedElements(const void *a, const void *b) {
+    const KeyedElement *x = a, *y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return x->element < y->element ? -1 : x->element > y->element;
+}
+
+void fillPartitionByKeys(Partition *partition, const size_t *keys) {
+    size_t size = 1L << partition->n;
+    KeyedElement *order = malloc(sizeof(KeyedElement) * size);
+    for (size_t x = 0; x < size; ++x) {
+        order[x].key = keys[x];
+        order[x].element = x;
+    }
+    // The keys may be as large as the dimension allows, so the elements are sorted instead of counted
+    qsort(order, size, sizeof(KeyedElement), compareKeyedElements);
+
+    size_t numBuckets = 0;
+    for (size_t j = 0; j < size; ++j) {
+        if (j == 0 || order[j].key != order[j - 1].key) {
+            partition->multiplicities[numBuckets] = order[j].key;
+            partition->bucketSizes[numBuckets] = 0;
+            partition->offsets[numBuckets] = j;
+            numBuckets += 1;
         }
+        partition->elements[j] = order[j].element;
+        partition->bucketOf[order[j].element] = numBuckets - 1;
+        partition->bucketSizes[numBuckets - 1] += 1;
     }
-    free(multiplicities);
-    return partition;
+    partition->offsets[numBuckets] = size;
+    partition->numBuckets = numBuckets;
+    free(order);
 }
 
 void destroyPartition(Partition *partition) {
-    for (int i = 0; i < partition->numBuckets; ++i) {
-        free(partition->buckets[i]);
-    }
-    free(partition->bucketSizes);
     free(partition->multiplicities);
-    free(partition->buckets);
+    free(partition->bucketSizes);
+    free(partition->offsets);
+    free(partition->elements);
+    free(partition->bucketOf);
+    free(partition->occurrences);
+    free(partition->bucketOfMultiplicity);
     free(partition);
 }
 
@@ -10,6 +10,12 @@
  * In structures, you will find all that is needed/used for the different structures.
  */
 
+/**
+ * The largest dimension n a function may have. Elements and inputs are held in size_t, and the affine searches walk
+ * 2^(2n) pairs of constants, so 2n must stay below the 64 bits of an index.
+ */
+#define MAX_DIMENSION 31
+
 /**
  * A truth table which holds the information of the n of the truth table and all its elements.
  */
@@ -49,6 +55,28 @@ TruthTable *compose(TruthTable *f, TruthTable *g);
  */
 TruthTable * inverse(TruthTable *f);
 
+/**
+ * Check if a function F is a permutation
+ * @param f The function F
+ * @return True if F is bijective, false otherwise
+ */
+bool isPermutation(TruthTable *f);
+
+/**
+ * Hash the elements of a truth table into a running FNV-1a hash
+ * @param hash The running hash, 14695981039346656037 to start a new hash
+ * @param tt The truth table
+ * @return The updated hash
+ */
+unsigned long long hashTruthTable(unsigned long long hash, TruthTable *tt);
+
+/**
+ * Compute the algebraic degree of F, i.e. the largest weight of a monomial in the algebraic normal form of F.
+ * @param f The function F
+ * @return The algebraic degree of F, 0 if F is constant
+ */
+size_t algebraicDegree(TruthTable *f);
+
 /**
  * Create a random affine function with 2^n elements
  * @param n The dimension
@@ -70,6 +98,13 @@ TruthTable *randomLinearPermutation(size_t n);
  */
 TruthTable *createAffineTruthTable(TruthTable *F);
 
+/**
+ * Create a new function G = A1 * F * A2 that is affine equivalent to F
+ * @param F The function F
+ * @return A new affine equivalent function G
+ */
+TruthTable *createAffineEquivalentFunction(TruthTable *F);
+
 /**
  * Create new linear truth table with respect to a function F where F and G are EA-equivalent
  * @param F The function F
@@ -83,6 +118,22 @@ TruthTable *createLinearFunction(TruthTable *F);
  */
 void printTruthTable(TruthTable *tt);
 
+/**
+ * Write all the elements of the TruthTable to a stream, separated by spaces and followed by an empty line. The
+ * elements are formatted into a large buffer, which is written to the stream in one call whenever it is full.
+ * @param tt The pointer to the truth table to write out
+ * @param stream The stream to write to
+ */
+void writeTruthTable(TruthTable *tt, FILE *stream);
+
+/**
+ * Format a number in decimal, without the printf machinery
+ * @param value The number
+ * @param out Receives the digits, without a terminating zero; 20 characters are always enough
+ * @return The number of characters written
+ */
+size_t formatNumber(size_t value, char *out);
+
 /**
  * Free the memory that is allocated for the struct TruthTable
  * @param tt The pointer for the TruthTable that is to be destroyed
@@ -92,13 +143,19 @@ void destroyTruthTable(TruthTable *tt);
 /**
  * Holds all the information for the Partition:
  * Number of buckets, all the multiplicities, the sizes of the buckets, and all the elements in all the buckets.
- *
+ * The buckets are sorted by multiplicity, and stored one after the other in a single list of elements, so bucket i
+ * is elements[offsets[i]] ... elements[offsets[i + 1] - 1]. The elements of a bucket are in increasing order.
  */
 typedef struct Partition {
+    size_t n; // The dimension of the partitioned function
     size_t numBuckets; // Number of buckets
-    size_t *multiplicities; // All the multiplicities that matches the buckets, this is a list of lists
+    size_t *multiplicities; // The multiplicity of each bucket, in increasing order
     size_t *bucketSizes; // A list that holds the information of the sizes of all the buckets
-    size_t **buckets; // A list of lists, holds the elements in each bucket.
+    size_t *offsets; // offsets[i] is the position of the first element of bucket i, offsets[numBuckets] = 2^n
+    size_t *elements; // The elements of all the buckets
+    size_t *bucketOf; // bucketOf[y] is the bucket containing the element y
+    size_t *occurrences; // Work space, the number of pre-images of each element
+    size_t *bucketOfMultiplicity; // Work space, the bucket of each multiplicity 0..2^n
 } Partition;
 
 /**
@@ -129,6 +186,23 @@ void printPartition(Partition *F);
  */
 Partition *partitionTt(TruthTable *tt);
 
+/**
+ * Partition a function into an existing Partition of the same dimension, without allocating any memory. The buckets
+ * are built by a counting sort over the multiplicities, in a linear number of steps.
+ * @param partition The Partition to overwrite
+ * @param tt The truth table to partition
+ */
+void fillPartition(Partition *partition, TruthTable *tt);
+
+/**
+ * Partition the elements 0..2^n - 1 by a key of each element into an existing Partition. Elements with the same key
+ * share a bucket, the buckets are sorted by key, and the key of a bucket is stored as its multiplicity, so that two
+ * partitions by the same kind of key can be matched with mapPreImages.
+ * @param partition The Partition to overwrite
+ * @param keys The key of each element
+ */
+void fillPartitionByKeys(Partition *partition, const size_t *keys);
+
 /**
  * Free the memory allocated for the Partition
  * @param partition The Partition to destroy
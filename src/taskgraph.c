@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include "taskgraph.h"
+
+TaskGraph *initTaskGraph(size_t threads) {
+    TaskGraph *graph = malloc(sizeof(TaskGraph));
+    graph->threads = threads > 0 ? threads : 1;
+    graph->capacity = 16;
+    graph->tasks = malloc(sizeof(Task *) * graph->capacity);
+    graph->numTasks = 0;
+    graph->ready = NULL;
+    graph->lastReady = NULL;
+    graph->finished = 0;
+    pthread_mutex_init(&graph->lock, NULL);
+    pthread_cond_init(&graph->changed, NULL);
+    return graph;
+}
+
+Task *addTask(TaskGraph *graph, void (*run)(void *), void *argument) {
+    Task *task = malloc(sizeof(Task));
+    task->run = run;
+    task->argument = argument;
+    task->prerequisites = 0;
+    task->capacity = 4;
+    task->dependents = malloc(sizeof(Task *) * task->capacity);
+    task->numDependents = 0;
+    task->next = NULL;
+    if (graph->numTasks == graph->capacity) {
+        graph->capacity *= 2;
+        graph->tasks = realloc(graph->tasks, sizeof(Task *) * graph->capacity);
+    }
+    graph->tasks[graph->numTasks++] = task;
+    return task;
+}
+
+void addDependency(Task *task, Task *prerequisite) {
+    if (prerequisite->numDependents == prerequisite->capacity) {
+        prerequisite->capacity *= 2;
+        prerequisite->dependents = realloc(prerequisite->dependents, sizeof(Task *) * prerequisite->capacity);
+    }
+    prerequisite->dependents[prerequisite->numDependents++] = task;
+    task->prerequisites += 1;
+}
+
+/**
+ * Append a task to the queue of tasks that are ready to run. The lock must be held.
+ */
+static void pushReady(TaskGraph *graph, Task *task) {
+    task->next = NULL;
+    if (graph->ready == NULL) {
+        graph->ready = task;
+    } else {
+        graph->lastReady->next = task;
+    }
+    graph->lastReady = task;
+}
+
+/**
+ * Take tasks from the queue and run them until all the tasks of the graph have finished
+ */
+static void *runTasks(void *argument) {
+    TaskGraph *graph = argument;
+    pthread_mutex_lock(&graph->lock);
+    while (true) {
+        while (graph->ready == NULL && graph->finished < graph->numTasks) {
+            pthread_cond_wait(&graph->changed, &graph->lock);
+        }
+        if (graph->finished == graph->numTasks) break;
+
+        Task *task = graph->ready;
+        graph->ready = task->next;
+        pthread_mutex_unlock(&graph->lock);
+        task->run(task->argument);
+        pthread_mutex_lock(&graph->lock);
+
+        graph->finished += 1;
+        for (size_t i = 0; i < task->numDependents; ++i) {
+            if (--task->dependents[i]->prerequisites == 0) {
+                pushReady(graph, task->dependents[i]);
+            }
+        }
+        pthread_cond_broadcast(&graph->changed);
+    }
+    pthread_mutex_unlock(&graph->lock);
+    return NULL;
+}
+
+void runTaskGraph(TaskGraph *graph) {
+    for (size_t i = 0; i < graph->numTasks; ++i) {
+        if (graph->tasks[i]->prerequisites == 0) {
+            pushReady(graph, graph->tasks[i]);
+        }
+    }
+    // No more threads than tasks are of any use
+    size_t workers = graph->threads < graph->numTasks ? graph->threads : graph->numTasks;
+    pthread_t *threads = malloc(sizeof(pthread_t) * workers);
+    for (size_t i = 1; i < workers; ++i) {
+        pthread_create(&threads[i], NULL, runTasks, graph);
+    }
+    runTasks(graph);
+    for (size_t i = 1; i < workers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+}
+
+void destroyTaskGraph(TaskGraph *graph) {
+    for (size_t i = 0; i < graph->numTasks; ++i) {
+        free(graph->tasks[i]->dependents);
+        free(graph->tasks[i]);
+    }
+    free(graph->tasks);
+    pthread_mutex_destroy(&graph->lock);
+    pthread_cond_destroy(&graph->changed);
+    free(graph);
+}
@@ -0,0 +1,77 @@
+#ifndef AFFINE_TASKGRAPH_H
+#define AFFINE_TASKGRAPH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/**
+ * In taskgraph, you will find a small thread pool that runs a graph of tasks: a task starts as soon as all the tasks
+ * it depends on have finished, on whichever thread is free. The preprocessing of a query is expressed this way, so
+ * that independent parts, such as the orthoderivatives of F and G, run at the same time.
+ */
+
+/**
+ * A unit of work in a task graph
+ */
+typedef struct Task {
+    void (*run)(void *argument); // The work to do
+    void *argument; // Passed to run
+    size_t prerequisites; // Number of tasks this task depends on that have not finished yet
+    struct Task **dependents; // The tasks that depend on this task
+    size_t numDependents; // Number of tasks that depend on this task
+    size_t capacity; // Number of dependents that fit in the array of dependents
+    struct Task *next; // The next task in the queue of tasks that are ready to run
+} Task;
+
+/**
+ * A graph of tasks, together with the threads that run it
+ */
+typedef struct TaskGraph {
+    size_t threads; // Number of threads running the tasks, including the calling thread
+    Task **tasks; // All the tasks of the graph
+    size_t numTasks; // Number of tasks in the graph
+    size_t capacity; // Number of tasks that fit in the array of tasks
+    Task *ready; // The first task that is ready to run, NULL if none is
+    Task *lastReady; // The last task that is ready to run
+    size_t finished; // Number of tasks that have finished
+    pthread_mutex_t lock; // Protects the queue and the counters
+    pthread_cond_t changed; // Signaled when a task becomes ready or the graph is done
+} TaskGraph;
+
+/**
+ * Initialize a new task graph without tasks
+ * @param threads Number of threads that run the tasks, including the calling thread
+ * @return A new task graph
+ */
+TaskGraph *initTaskGraph(size_t threads);
+
+/**
+ * Add a task to the graph
+ * @param graph The task graph
+ * @param run The work to do
+ * @param argument Passed to run
+ * @return The new task, owned by the graph
+ */
+Task *addTask(TaskGraph *graph, void (*run)(void *), void *argument);
+
+/**
+ * Make a task wait for another task to finish before it starts
+ * @param task The task that waits
+ * @param prerequisite The task to wait for
+ */
+void addDependency(Task *task, Task *prerequisite);
+
+/**
+ * Run all the tasks of the graph, and return when all of them have finished
+ * @param graph The task graph, which must not have cycles
+ */
+void runTaskGraph(TaskGraph *graph);
+
+/**
+ * Free the memory allocated for the task graph and its tasks
+ * @param graph The task graph to destroy
+ */
+void destroyTaskGraph(TaskGraph *graph);
+
+#endif //AFFINE_TASKGRAPH_H